@@ -0,0 +1,8 @@
+// the build-time benchmark: the one file compiling the framework for the generated suite (see CMakeLists.txt).
+// what is measured is the time to build the suite's files, so this only runs them.
+#define PICOTEST_IMPLEMENTATION
+#include "picotest.h"
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,17 @@
+// the startup benchmark: registers PICOTEST_STARTUP_TESTS tests (see CMakeLists.txt) and reports how long
+// building the registry and running them took. static initialization happens before main, so time the
+// whole process for it, e.g. "time ./startup --picotest_list_tests > /dev/null".
+#define PICOTEST_IMPLEMENTATION
+#include "picotest.h"
+
+#include <chrono>
+#include <cstdio>
+
+int main(int argc, char** argv) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const int result = RUN_ALL_TESTS(argc, argv);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "%.1f ms in RUN_ALL_TESTS\n", ms);
+    return result;
+}
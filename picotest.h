@@ -26,32 +26,30 @@
 */
 #pragma once
 
-#include <vector>
-#include <iostream>
-#include <functional>
-#include <iomanip>
-#include <string>
-#include <sstream>
-#include <algorithm>
+// separate compilation: define PICOTEST_SEPARATE_COMPILATION for the whole project, and PICOTEST_IMPLEMENTATION
+// as well in one translation unit, which then compiles the framework (and typically holds main). other files get
+// a light header with TEST/TEST_F/TEST_P, fixtures, environments, EXPECT_/ASSERT_ on values, strings, EXPECT_MEM_EQ
+// and EXPECT_MATCHES_GOLDEN; a file which needs more (benchmarks, stress tests, properties, coroutine tests, array
+// and percentile assertions, ...) defines PICOTEST_FULL_HEADER.
+// without PICOTEST_SEPARATE_COMPILATION everything is inline and any one file may call RUN_ALL_TESTS.
+#ifdef PICOTEST_SEPARATE_COMPILATION
+#define PICOTEST_API
+#if !defined PICOTEST_IMPLEMENTATION && !defined PICOTEST_FULL_HEADER
+#define PICOTEST_LIGHT
+#endif
+#else
+#define PICOTEST_API inline
+#endif
 
-#include <cstdio>
-#include <cassert>
+// kept to what every translation unit needs: a light one gets no <sstream> (see StringStream) and no <cmath>.
+// <tuple> stays for Combine, whose parameters are std::tuples; <type_traits> comes with <string> anyway
 #include <cstdint>
-#include <cstdarg>
 #include <cstring>
-#include <cmath>
-
-#if defined _WIN32 
-#define PICOTEST_WINDOWS
-#ifndef NOMINMAX
-#define NOMINMAX
-#endif // ifdef NOMINMAX
-#include <Windows.h>
-#elif defined __linux__
-#define PICOTEST_LINUX
-#endif
-
-
+#include <string>
+#include <ostream>
+#include <vector>
+#include <tuple>
+#include <type_traits>
 
 /////////////////////////////////////////////////////////////////
 // helper macros
@@ -65,78 +63,32 @@ void operator = (const typeName&);\
 typeName(const typeName&)
 
 /////////////////////////////////////////////////////////////////
-// internal
+// declarations shared by the light and the full header
 
 namespace picotest {
 namespace detail {
-    /***** print with color *****/
-
-    enum Color {
-        COLOR_RED,
-        COLOR_GREEN
-    };
-
-#ifdef PICOTEST_WINDOWS
-    inline WORD getColorAttr(Color c) {
-        switch (c) {
-        case COLOR_RED:    return FOREGROUND_RED;
-        case COLOR_GREEN:  return FOREGROUND_GREEN;
-        default:           assert(0); return 0;
-        }
-    }
-#else
-    inline const char* getColorEscape(Color c) {
-        switch (c) {
-        case COLOR_RED:    return "\x1b[41m";
-        case COLOR_GREEN:  return "\x1b[32m";
-        default:           assert(0); return "";
-        }
-    }
-#endif
-
-    inline void coloredPrint(Color c, const char* fmt, ...) {
-        va_list args;
-        va_start(args, fmt);
-
-#ifdef PICOTEST_WINDOWS
-        const HANDLE std_handle = ::GetStdHandle(STD_OUTPUT_HANDLE);
-
-        CONSOLE_SCREEN_BUFFER_INFO buffer_info;
-        ::GetConsoleScreenBufferInfo(std_handle, &buffer_info);
-        const WORD old_color = buffer_info.wAttributes;
-        const WORD new_color  = getColorAttr(c) | FOREGROUND_INTENSITY;
-
-        fflush(stdout);
-        ::SetConsoleTextAttribute(std_handle, new_color);
+    /***** stringize *****/
 
-        vprintf(fmt, args);
+    PICOTEST_API std::string toString(const void* addr, int size);
 
-        fflush(stdout);
-        ::SetConsoleTextAttribute(std_handle, old_color);
-#else
-        printf("%s", getColorEscape(c));
-        vprintf(fmt, args);
-        printf("\033[m");
-#endif
-        va_end(args);
-    }
+    PICOTEST_API std::ostream* newStringStream();
+    PICOTEST_API std::string stringStreamContent(const std::ostream& os);
+    PICOTEST_API void deleteStringStream(std::ostream* os);
 
-    /***** stringize *****/
+    // an std::ostringstream created out of line, so that a light translation unit need not include <sstream>
+    class StringStream {
+    public:
+        StringStream() : os_(newStringStream()) {}
+        ~StringStream() { deleteStringStream(os_); }
 
-    inline std::string toString(const void* addr, int size) {
-        const unsigned char *p = reinterpret_cast<const unsigned char*>(addr);
-        std::ostringstream os;
-        int maxsize = size > 10 ? 10 : size;
+        std::ostream& os() { return *os_; }
+        std::string str() const { return stringStreamContent(*os_); }
 
-        os << "[";
-        for (int i = 0; i < maxsize; i++, p++)
-            os << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(*p) << ((i == size - 1) ? "" : " ");
-        if (maxsize > size)
-            os << "...";
-        os << "]";
+    private:
+        std::ostream* os_;
 
-        return os.str();
-    }
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(StringStream);
+    };
 
     // fallback operator <<
     template <typename Char, typename CharTraits, typename T>
@@ -156,9 +108,9 @@ namespace detail {
 
     template<typename T>
     std::string toString(const T& v) {
-        std::ostringstream os;
-        os << v;
-        return os.str();
+        StringStream s;
+        s.os() << v;
+        return s.str();
     }
 
     inline std::string toString(bool b) {
@@ -167,13 +119,57 @@ namespace detail {
 
     template<typename T, typename A>
     std::string toString(const std::vector<T,A>& v) {
-        std::ostringstream os;
-        os << "{";
+        StringStream s;
+        s.os() << "{";
         for (size_t i = 0; i < v.size(); i++)
-            os << v[i] << (i == v.size() - 1 ? "}" : ",");
-        return os.str();
+            s.os() << v[i] << (i == v.size() - 1 ? "}" : ",");
+        return s.str();
+    }
+
+    template<typename... T>
+    std::string toString(const std::tuple<T...>& t);
+
+    template<typename Tuple, std::size_t N>
+    struct TuplePrinter {
+        static void print(std::ostream& os, const Tuple& t) {
+            TuplePrinter<Tuple, N - 1>::print(os, t);
+            os << ", " << toString(std::get<N - 1>(t));
+        }
+    };
+
+    template<typename Tuple>
+    struct TuplePrinter<Tuple, 1> {
+        static void print(std::ostream& os, const Tuple& t) {
+            os << toString(std::get<0>(t));
+        }
+    };
+
+    template<typename Tuple>
+    struct TuplePrinter<Tuple, 0> {
+        static void print(std::ostream&, const Tuple&) {}
+    };
+
+    template<typename... T>
+    std::string toString(const std::tuple<T...>& t) {
+        StringStream s;
+        s.os() << "(";
+        TuplePrinter<std::tuple<T...>, sizeof...(T)>::print(s.os(), t);
+        s.os() << ")";
+        return s.str();
     }
 
+    // 0, 1, ..., N-1 as a parameter pack
+    template<std::size_t... I>
+    struct Indices {};
+
+    template<std::size_t N, std::size_t... I>
+    struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+    template<std::size_t... I>
+    struct MakeIndices<0, I...> {
+        typedef Indices<I...> type;
+    };
+
     template<typename T1, typename T2, typename OP>
     std::string makeExpressionStr(const T1& v1, const T2& v2, OP op) {
         return toString(v1) + " " + op.name() + " " + toString(v2);
@@ -231,421 +227,7097 @@ namespace detail {
             v2_.value = v2;
             return distance(v1_.raw, v2_.raw) <= MIN_UPS;
         }
+
+        static uint64_t ulps(float v1, float v2) {
+            float_ v1_, v2_;
+            v1_.value = v1;
+            v2_.value = v2;
+            return distance(v1_.raw, v2_.raw);
+        }
+
+        static uint64_t ulps(double v1, double v2) {
+            double_ v1_, v2_;
+            v1_.value = v1;
+            v2_.value = v2;
+            return distance(v1_.raw, v2_.raw);
+        }
     };
 
-    /***** stricmp/strcasecmp *****/
-    inline int stricmp(const char* c1, const char* c2) {
-#ifdef PICOTEST_WINDOWS
-        return _stricmp(c1, c2);
-#else
-        return strcasecmp(c1, c2);
-#endif
-    }
+    /***** |e - a| *****/
 
+    // unlike std::abs(e - a), also right for unsigned types (where e - a wraps around). a NaN is never near anything
+    template<typename T1, typename T2>
+    auto absDifference(const T1& e, const T2& a) -> decltype(e - a) {
+        return e > a ? e - a : a - e;
+    }
 
-}
+    /***** stricmp/strcasecmp *****/
+    PICOTEST_API int stricmp(const char* c1, const char* c2);
 
-/////////////////////////////////////////////////////////////////
-// framework
+} // namespace picotest::detail
 
 namespace framework {
 
-class  TestCase;
-class  Test;
+// global setup shared by all tests, registered with testing::AddGlobalTestEnvironment.
+// SetUp runs once before the first test, TearDown once after the last (in reverse order of registration).
+// with --picotest_fork, workers are forked after SetUp and so inherit what it prepared.
+class Environment {
+public:
+    virtual ~Environment() {}
+    virtual void SetUp() {}
+    virtual void TearDown() {}
+};
 
-enum TestReportMode {
-    TestReportOnlyFailure,
-    TestReportForEach
+// descriptor emitted by TEST/TEST_F. it is a POD constant-initialized at compile time,
+// so registering a test allocates nothing and does not depend on static-initialization order.
+struct TestInfo {
+    const char* test_case_name;
+    const char* test_name;
+    void (*func)(void);
+    unsigned flags; // TestFlags
+    void (*set_up_test_case)(void);
+    void (*tear_down_test_case)(void);
+    double timeout_ms; // 0 = TestState::getTimeoutMs()
+    TestInfo* next;
 };
 
-struct TestState {
-    TestState() : testcase_(0), test_(0), reportmode_(TestReportForEach) {}
+// the SetUpTestCase/TearDownTestCase of a fixture for the registrars, even where the fixture declares them
+// protected (as googletest allows). never instantiated
+template<typename Fixture>
+struct FixtureHooks : public Fixture {
+    static void setUpTestCase() { Fixture::SetUpTestCase(); }
+    static void tearDownTestCase() { Fixture::TearDownTestCase(); }
+};
 
-    static TestState& getInstance() {
-        static TestState instance;
+// intrusive list of all descriptors, in registration order
+struct TestList {
+    TestInfo* head;
+    TestInfo* tail;
+
+    static TestList& getInstance() {
+        static TestList instance = { 0, 0 }; // constant-initialized
         return instance;
     }
 
-    static TestCase* getCurrentTestCase() {
-        return getInstance().testcase_;
+    void append(TestInfo& info) {
+        info.next = 0;
+        if (tail) tail->next = &info;
+        else      head = &info;
+        tail = &info;
     }
+};
 
-    static Test* getCurrentTest() {
-        return getInstance().test_;
+struct TestLink {
+    explicit TestLink(TestInfo& info) {
+        TestList::getInstance().append(info);
     }
+};
 
-    static void setCurrentTestCase(TestCase* testcase) {
-        getInstance().testcase_ = testcase;
+// descriptor emitted by TEST_P: a test pattern, which runs once per parameter of each INSTANTIATE_TEST_CASE_P
+// of its fixture. func constructs and runs the test with the parameter set by the instantiation.
+struct ParamTestInfo {
+    const char* test_name;
+    void (*func)(void);
+    ParamTestInfo* next;
+};
+
+// the TEST_P patterns of one fixture, in registration order
+struct ParamTestList {
+    ParamTestInfo* head;
+    ParamTestInfo* tail;
+
+    void append(ParamTestInfo& info) {
+        info.next = 0;
+        if (tail) tail->next = &info;
+        else      head = &info;
+        tail = &info;
     }
+};
 
-    static void setCurrentTest(Test* test) {
-        getInstance().test_ = test;
+template<typename Fixture>
+ParamTestList& paramTests() {
+    static ParamTestList instance = { 0, 0 }; // constant-initialized
+    return instance;
+}
+
+struct ParamTestLink {
+    ParamTestLink(ParamTestList& list, ParamTestInfo& info) {
+        list.append(info);
     }
+};
 
-    static TestReportMode getReportMode() {
-        return getInstance().reportmode_;
+// descriptor emitted by INSTANTIATE_TEST_CASE_P. the generator stays type-erased behind the function pointers;
+// parameters are produced one at a time, by index, when a test runs.
+struct ParamInstantiationInfo {
+    const char* prefix;
+    const char* test_case_name;
+    const ParamTestList* tests;
+    const void* generator;
+    std::size_t (*size)(const void* generator);
+    void (*run)(const void* generator, std::size_t index, void (*func)(void)); // runs func with parameter #index
+    std::string (*describe)(const void* generator, std::size_t index); // parameter #index, printed
+    void (*set_up_test_case)(void);
+    void (*tear_down_test_case)(void);
+    ParamInstantiationInfo* next;
+};
+
+struct ParamInstantiationList {
+    ParamInstantiationInfo* head;
+    ParamInstantiationInfo* tail;
+
+    static ParamInstantiationList& getInstance() {
+        static ParamInstantiationList instance = { 0, 0 }; // constant-initialized
+        return instance;
     }
 
-    static void setReportMode(TestReportMode mode) {
-        getInstance().reportmode_ = mode;
+    void append(ParamInstantiationInfo& info) {
+        info.next = 0;
+        if (tail) tail->next = &info;
+        else      head = &info;
+        tail = &info;
     }
+};
 
-private:
-    PICOTEST_DISALLOW_COPY_AND_ASSIGN(TestState);
+// an assertion failed at file:line. returns whether its message should be built and passed to addFailure;
+// otherwise the failure is only counted (see Test::countFailure)
+PICOTEST_API bool countFailure(const char* file, int line);
 
-    TestCase* testcase_;
-    Test* test_;
-    TestReportMode reportmode_;
-};
+PICOTEST_API void addFailure(const char* file, int line, const std::string& message);
 
-struct Failure {
-    Failure(const std::string& file, int line, const std::string& expected, const std::string& actual)
-        : file(file), line(line), message(detail::makeMessage(expected, actual)) {}
+} // namespace picotest::framework
 
-    Failure(const std::string& file, int line, const std::string& expression, bool expected)
-        : file(file), line(line), message(detail::makeMessage(expression, expected)) {}
+/***** binary operators *****/
 
-    Failure() {}
-    std::string file;
-    int line;
-    std::string message;
+struct LT {
+    template <typename T1, typename T2>
+    bool operator()(const T1& lhs, const T2& rhs) { return lhs < rhs; }
+    static std::string name() { return "<"; }
 };
 
-class Test {
-public:
-    typedef std::vector<Failure> Failures;
-    typedef void (*TestFunc)(void);
-
-    Test (const std::string& name, TestFunc f) : executed_(false), name_(name), f_(f) {}
+struct GT {
+    template <typename T1, typename T2>
+    bool operator()(const T1& lhs, const T2& rhs) { return lhs > rhs; }
+    static std::string name() { return ">"; }
+};
 
-    void execute() {
-        TestState::setCurrentTest(this);
-        f_();
-        executed_ = true;
-    }
+struct LE {
+    template <typename T1, typename T2>
+    bool operator()(const T1& lhs, const T2& rhs) { return lhs <= rhs; }
+    static std::string name() { return "<="; }
+};
 
-    const std::string& name() const {
-        return name_;
-    }
+struct GE {
+    template <typename T1, typename T2>
+    bool operator()(const T1& lhs, const T2& rhs) { return lhs >= rhs; }
+    static std::string name() { return ">="; }
+};
 
-    bool success() const {
-        return executed_ && failures_.empty();
-    }
+struct EQ {
+    template <typename T1, typename T2>
+    bool operator()(const T1& lhs, const T2& rhs) { return lhs == rhs; }
 
-    void setFailure(const Failure& failure) {
-        failures_.push_back(failure);
+    // use when comparing against null
+    template <typename T>
+    bool operator()(int lhs, T* const rhs) {
+        return reinterpret_cast<const int*>(lhs) == rhs;
     }
 
-    template<typename Char, typename CharTraits>
-    void reportFailure(std::basic_ostream<Char, CharTraits>& os) const {
-        for (Failures::const_iterator it = failures_.begin(), end = failures_.end(); it != end; ++it) 
-            report(os, (*it));
+    template <typename T>
+    bool operator()(T* const lhs, int rhs) {
+        return lhs == reinterpret_cast<const int*>(rhs);
     }
 
-private:
-    template<typename Char, typename CharTraits>
-    void report(std::basic_ostream<Char, CharTraits>& os, const Failure& f) const {
-        os << name_ << " : " << f.file << "(" << f.line << "): " << f.message << std::endl;
-    }
+    static std::string name() { return "=="; }
+};
 
-    bool executed_;
-    Failures failures_;
-    std::string name_;
-    TestFunc f_;
+struct NE {
+    template <class T1, class T2>
+    bool operator()(const T1& lhs, const T2& rhs) { return !EQ()(lhs, rhs); }
+    static std::string name() { return "!="; }
 };
 
-class TestCase {
-public:
-    typedef std::vector<Test> Tests;
+struct STREQ {
+    bool operator()(const char* lhs, const char* rhs) { return strcmp(lhs, rhs) == 0; }
+    static std::string name() { return "=="; }
+};
 
-    TestCase() {}
-    TestCase(const std::string& name) : executed_(false), name_(name) {}
+struct STRNE {
+    bool operator()(const char* lhs, const char* rhs) { return strcmp(lhs, rhs) != 0; }
+    static std::string name() { return "!="; }
+};
 
-    void add(const Test&t) {
-        tests_.push_back(t);
+struct STRCASEEQ {
+    bool operator()(const char* lhs, const char* rhs) { 
+        return detail::stricmp(lhs, rhs) == 0; 
     }
+    static std::string name() { return "=="; }
+};
 
-    template<typename Char, typename CharTraits>
-    void execute(std::basic_ostream<Char, CharTraits>& os) {
-        TestState::setCurrentTestCase(this);
-     
-        std::for_each(tests_.begin(), tests_.end(), std::mem_fun_ref(&Test::execute));
-
-        executed_ = true;
+struct STRCASENE {
+    bool operator()(const char* lhs, const char* rhs) { 
+        return detail::stricmp(lhs, rhs) != 0; 
 
-        if (TestState::getReportMode() == TestReportForEach)
-            report(os);
     }
+    static std::string name() { return "!="; }
+};
+
+struct FLOATEQ {
+    template<typename T>
+    bool operator()(const T& lhs, const T& rhs) {
+        return detail::Floating::almostEqual(lhs, rhs);
+    }
+    static std::string name() { return "=="; }
+};
+
+struct FLOATNE {
+    template<typename T>
+    bool operator()(const T& lhs, const T& rhs) {    
+        return !FLOATEQ()(lhs, rhs);
+    }
+    static std::string name() { return "!="; }
+};
+
+/***** compare implementation *****/
+
+template<typename T1, typename T2, typename OP>
+bool compare(const T1& expected, const T2& actual, OP op, 
+             const char* expected_str, const char* actual_str, const char* file, int line) {
+    bool test_success = op(expected, actual);
+
+    if (!test_success) {
+        if (framework::countFailure(file, line)) framework::addFailure(file, line,
+            detail::makeMessage(detail::makeExpressionStr(expected_str, actual_str, op),
+                                detail::makeExpressionStr(expected, actual, op)));
+    }
+    return test_success;
+}
+
+template<typename T1, typename T2, typename T3>
+bool compare_near(const T1& expected, const T2& actual, const T3& abs_error, 
+             const char* expected_str, const char* actual_str, const char* file, int line) {
+    bool test_success = detail::absDifference(expected, actual) <= abs_error;
+
+    if (!test_success) {
+        if (framework::countFailure(file, line)) framework::addFailure(file, line,
+            detail::makeMessage(detail::makeExpressionStr(expected_str, actual_str, picotest::FLOATEQ()),
+                                detail::makeExpressionStr(expected, actual, picotest::FLOATEQ())));
+    }
+    return test_success;
+}
+
+PICOTEST_API bool compare_mem(const void* expected, const void* actual, std::size_t size,
+                              const char* expected_str, const char* actual_str, const char* file, int line);
+
+namespace detail {
+    // what EXPECT_MATCHES_GOLDEN compares: the bytes of a std::string, a std::vector, a C string, or of anything
+    // else with contiguous data() and size()
+    struct ByteView {
+        const void* data;
+        std::size_t size;
+    };
+
+    template<typename Container>
+    ByteView byteView(const Container& c) {
+        ByteView view = { c.data(), c.size() * sizeof(*c.data()) };
+        return view;
+    }
+
+    inline ByteView byteView(const char* s) {
+        ByteView view = { s, strlen(s) };
+        return view;
+    }
+} // namespace picotest::detail
+
+PICOTEST_API bool compare_golden(const detail::ByteView& actual, const std::string& path,
+                                 const char* actual_str, const char* file, int line);
+
+inline bool evaluate(bool expected, bool actual, const char* expression, const char* file, int line) {
+    bool test_success = expected == actual;
+
+    if (!test_success) {
+        if (framework::countFailure(file, line))
+            framework::addFailure(file, line, detail::makeMessage(expression, expected));
+    }
+
+    return test_success;
+}
+
+} // namespace picotest
+
+// using namespace testing for compatibility with google test
+namespace testing {
+
+class Test {
+public:
+    Test() {}
+    virtual ~Test() {}
+    void execute() {
+        SetUp();
+        test_method(); // template-method
+        TearDown();
+    }
+
+    // run once per testcase, around all of its tests; a fixture hides these to share expensive
+    // state (in static members) between its tests
+    static void SetUpTestCase() {}
+    static void TearDownTestCase() {}
+protected:
+    virtual void SetUp() {}
+    virtual void TearDown() {}
+    virtual void test_method() = 0;
+};
+
+typedef picotest::framework::Environment Environment;
+
+// takes ownership; call before RUN_ALL_TESTS
+PICOTEST_API Environment* AddGlobalTestEnvironment(Environment* env);
+
+/***** value-parameterized tests *****/
+
+// GetParam() is the parameter the test was constructed for
+template<typename T>
+class WithParamInterface {
+public:
+    typedef T ParamType;
+
+    WithParamInterface() : param_(current()) {}
+    virtual ~WithParamInterface() {}
+
+    const ParamType& GetParam() const {
+        return *param_;
+    }
+
+    // the parameter of the tests constructed on this thread (set by INSTANTIATE_TEST_CASE_P)
+    static const ParamType*& current() {
+        static thread_local const ParamType* param = 0;
+        return param;
+    }
+
+private:
+    const ParamType* param_;
+};
+
+template<typename T>
+class TestWithParam : public Test, public WithParamInterface<T> {};
+
+// parameter generators. a generator is any copyable type with
+//   typedef ... value_type;
+//   std::size_t size() const;
+//   value_type at(std::size_t index) const;
+// at() is called once per test, so a generator never holds more than its definition (Range, Combine)
+// or its values (Values, ValuesIn) in memory.
+
+template<typename T, typename IncrementT>
+class RangeGenerator {
+public:
+    typedef T value_type;
+
+    RangeGenerator(T begin, T end, IncrementT step) : begin_(begin), step_(step), size_(0) {
+        if (begin < end) {
+            size_ = static_cast<std::size_t>((end - begin) / step);
+            if (at(size_) < end) size_++;
+        }
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+    value_type at(std::size_t index) const {
+        return static_cast<T>(begin_ + static_cast<IncrementT>(index) * step_);
+    }
+
+private:
+    T begin_;
+    IncrementT step_;
+    std::size_t size_;
+};
+
+template<typename T, std::size_t N>
+class ValuesGenerator {
+public:
+    typedef T value_type;
+
+    template<typename... Args>
+    explicit ValuesGenerator(const Args&... args) : values_{ static_cast<T>(args)... } {}
+
+    std::size_t size() const {
+        return N;
+    }
+
+    value_type at(std::size_t index) const {
+        return values_[index];
+    }
+
+private:
+    T values_[N];
+};
+
+template<typename T>
+class ValuesInGenerator {
+public:
+    typedef T value_type;
+
+    template<typename Iterator>
+    ValuesInGenerator(Iterator begin, Iterator end) : values_(begin, end) {}
+
+    std::size_t size() const {
+        return values_.size();
+    }
+
+    value_type at(std::size_t index) const {
+        return values_[index];
+    }
+
+private:
+    std::vector<T> values_;
+};
+
+// the cartesian product; index is read as a mixed-radix number whose last digit selects from the last generator
+template<typename... Generators>
+class CombineGenerator {
+public:
+    typedef std::tuple<typename Generators::value_type...> value_type;
+
+    explicit CombineGenerator(const Generators&... generators) : generators_(generators...) {}
 
+    std::size_t size() const {
+        return stride(std::integral_constant<std::size_t, 0>());
+    }
+
+    value_type at(std::size_t index) const {
+        return at(index, typename picotest::detail::MakeIndices<sizeof...(Generators)>::type());
+    }
+
+private:
+    template<std::size_t... I>
+    value_type at(std::size_t index, picotest::detail::Indices<I...>) const {
+        return value_type(std::get<I>(generators_).at(
+            index / stride(std::integral_constant<std::size_t, I + 1>()) % std::get<I>(generators_).size())...);
+    }
+
+    // product of the sizes of generators I..
+    template<std::size_t I>
+    std::size_t stride(std::integral_constant<std::size_t, I>) const {
+        return std::get<I>(generators_).size() * stride(std::integral_constant<std::size_t, I + 1>());
+    }
+
+    std::size_t stride(std::integral_constant<std::size_t, sizeof...(Generators)>) const {
+        return 1;
+    }
+
+    std::tuple<Generators...> generators_;
+};
+
+// begin, begin + step, ... while < end
+template<typename T, typename IncrementT>
+RangeGenerator<T, IncrementT> Range(T begin, T end, IncrementT step) {
+    return RangeGenerator<T, IncrementT>(begin, end, step);
+}
+
+template<typename T>
+RangeGenerator<T, T> Range(T begin, T end) {
+    return RangeGenerator<T, T>(begin, end, 1);
+}
+
+template<typename T, typename... Rest>
+ValuesGenerator<typename std::common_type<T, Rest...>::type, 1 + sizeof...(Rest)> Values(T first, Rest... rest) {
+    return ValuesGenerator<typename std::common_type<T, Rest...>::type, 1 + sizeof...(Rest)>(first, rest...);
+}
+
+inline ValuesGenerator<bool, 2> Bool() {
+    return ValuesGenerator<bool, 2>(false, true);
+}
+
+template<typename Container>
+ValuesInGenerator<typename Container::value_type> ValuesIn(const Container& values) {
+    return ValuesInGenerator<typename Container::value_type>(values.begin(), values.end());
+}
+
+template<typename T, std::size_t N>
+ValuesInGenerator<T> ValuesIn(const T (&values)[N]) {
+    return ValuesInGenerator<T>(values, values + N);
+}
+
+template<typename Iterator>
+ValuesInGenerator<typename std::iterator_traits<Iterator>::value_type> ValuesIn(Iterator begin, Iterator end) {
+    return ValuesInGenerator<typename std::iterator_traits<Iterator>::value_type>(begin, end);
+}
+
+template<typename... Generators>
+CombineGenerator<Generators...> Combine(const Generators&... generators) {
+    return CombineGenerator<Generators...>(generators...);
+}
+
+} // namespace testing
+
+namespace picotest {
+namespace framework {
+
+// the object behind INSTANTIATE_TEST_CASE_P: owns the generator and registers its descriptor
+template<typename Fixture, typename Generator>
+class ParamInstantiation {
+public:
+    typedef typename Fixture::ParamType ParamType;
+
+    ParamInstantiation(const char* prefix, const char* test_case_name, const Generator& generator)
+        : generator_(generator) {
+        ParamInstantiationInfo info = { prefix, test_case_name, &paramTests<Fixture>(), &generator_, &size, &run,
+                                        &describe, &FixtureHooks<Fixture>::setUpTestCase,
+                                        &FixtureHooks<Fixture>::tearDownTestCase, 0 };
+        info_ = info;
+        ParamInstantiationList::getInstance().append(info_);
+    }
+
+private:
+    static std::size_t size(const void* generator) {
+        return static_cast<const Generator*>(generator)->size();
+    }
+
+    static void run(const void* generator, std::size_t index, void (*func)(void)) {
+        const ParamType param(static_cast<const Generator*>(generator)->at(index));
+        const ParamType*& current = ::testing::WithParamInterface<ParamType>::current();
+        current = &param;
+        func();
+        current = 0;
+    }
+
+    static std::string describe(const void* generator, std::size_t index) {
+        return detail::toString(ParamType(static_cast<const Generator*>(generator)->at(index)));
+    }
+
+    Generator generator_;
+    ParamInstantiationInfo info_;
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(ParamInstantiation);
+};
+
+} // namespace picotest::framework
+} // namespace picotest
+
+PICOTEST_API int RUN_ALL_TESTS();
+PICOTEST_API int RUN_ALL_TESTS(int argc, char** argv);
+
+#ifndef PICOTEST_LIGHT
+
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+#include <map>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <condition_variable>
+#include <random>
+#include <new>
+#include <limits>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+
+#if defined _WIN32 
+#define PICOTEST_WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // ifdef NOMINMAX
+#include <Windows.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined __linux__
+#define PICOTEST_LINUX
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#endif
+
+#if defined __unix__ || defined __APPLE__
+#define PICOTEST_POSIX
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <cerrno>
+#if defined __GLIBC__ || defined __APPLE__
+#define PICOTEST_BACKTRACE
+#include <execinfo.h>
+#endif
+#endif
+
+#ifndef PICOTEST_NO_SIMD
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define PICOTEST_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#define PICOTEST_AVX2
+#include <immintrin.h>
+#endif
+#endif // ifndef PICOTEST_NO_SIMD
+
+// CO_TEST needs C++20 coroutines
+#if defined __cpp_impl_coroutine && defined __has_include
+#if __has_include(<coroutine>)
+#define PICOTEST_COROUTINES
+#include <coroutine>
+#include <optional>
+#endif
+#endif
+
+
+
+/////////////////////////////////////////////////////////////////
+// internal
+
+namespace picotest {
+namespace detail {
+    /***** buffered output *****/
+
+    // set for runs where a test has a timeout: a hung test ends the process without draining anything
+    // (see Watchdog::expire), so every flush() drains
+    inline std::atomic<bool>& drainOnFlush() {
+        static std::atomic<bool> drain(false);
+        return drain;
+    }
+
+    // collects output in a large buffer and hands it to the sink (a stream or a FILE*) only when
+    // the buffer is full, on drain(), or on flush() if the last drain is older than the flush interval.
+    // this keeps per-line flushing off the hot path while bounding what a crash can lose.
+    class BufferedStreamBuf : public std::streambuf {
+    public:
+        explicit BufferedStreamBuf(std::ostream& sink, std::size_t size = 1 << 16)
+            : sink_(&sink), file_(0), buf_(size), last_drain_(std::chrono::steady_clock::now()) {
+            setp(&buf_[0], &buf_[0] + buf_.size());
+        }
+
+        explicit BufferedStreamBuf(FILE* file, std::size_t size = 1 << 16)
+            : sink_(0), file_(file), buf_(size), last_drain_(std::chrono::steady_clock::now()) {
+            setp(&buf_[0], &buf_[0] + buf_.size());
+        }
+
+        ~BufferedStreamBuf() {
+            drain();
+        }
+
+        void drain() {
+            const std::ptrdiff_t n = pptr() - pbase();
+            if (n > 0) {
+                if (sink_) sink_->write(pbase(), n);
+                if (file_) fwrite(pbase(), 1, static_cast<std::size_t>(n), file_);
+            }
+            if (sink_) sink_->flush();
+            if (file_) fflush(file_);
+
+            setp(&buf_[0], &buf_[0] + buf_.size());
+            last_drain_ = std::chrono::steady_clock::now();
+        }
+
+    protected:
+        int_type overflow(int_type c) {
+            drain();
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        int sync() {
+            if (drainOnFlush() || std::chrono::steady_clock::now() - last_drain_ >= std::chrono::milliseconds(100))
+                drain();
+            return 0;
+        }
+
+    private:
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(BufferedStreamBuf);
+
+        std::ostream* sink_;
+        FILE* file_;
+        std::vector<char> buf_;
+        std::chrono::steady_clock::time_point last_drain_;
+    };
+
+    class BufferedOStream : public std::ostream {
+    public:
+        explicit BufferedOStream(std::ostream& sink) : std::ostream(0), buf_(sink) { rdbuf(&buf_); }
+        explicit BufferedOStream(FILE* file) : std::ostream(0), buf_(file) { rdbuf(&buf_); }
+
+        void drain() {
+            buf_.drain();
+        }
+
+    private:
+        BufferedStreamBuf buf_;
+    };
+
+    // flush which bypasses the rate limit of BufferedStreamBuf
     template<typename Char, typename CharTraits>
-    void report(std::basic_ostream<Char, CharTraits>& os) const {
-        os << name_ << ":";
+    void flushNow(std::basic_ostream<Char, CharTraits>& os) {
+        if (BufferedStreamBuf* buf = dynamic_cast<BufferedStreamBuf*>(os.rdbuf())) buf->drain();
+        os.flush();
+    }
+
+    /***** print with color *****/
+
+    enum Color {
+        COLOR_RED,
+        COLOR_GREEN
+    };
+
+#ifdef PICOTEST_WINDOWS
+    inline WORD getColorAttr(Color c) {
+        switch (c) {
+        case COLOR_RED:    return FOREGROUND_RED;
+        case COLOR_GREEN:  return FOREGROUND_GREEN;
+        default:           assert(0); return 0;
+        }
+    }
+#else
+    inline const char* getColorEscape(Color c) {
+        switch (c) {
+        case COLOR_RED:    return "\x1b[41m";
+        case COLOR_GREEN:  return "\x1b[32m";
+        default:           assert(0); return "";
+        }
+    }
+#endif
+
+    template<typename Char, typename CharTraits>
+    void coloredPrint(std::basic_ostream<Char, CharTraits>& os, Color c, const char* str) {
+#ifdef PICOTEST_WINDOWS
+        const HANDLE std_handle = ::GetStdHandle(STD_OUTPUT_HANDLE);
+
+        CONSOLE_SCREEN_BUFFER_INFO buffer_info;
+        ::GetConsoleScreenBufferInfo(std_handle, &buffer_info);
+        const WORD old_color = buffer_info.wAttributes;
+
+        flushNow(os);
+        ::SetConsoleTextAttribute(std_handle, getColorAttr(c) | FOREGROUND_INTENSITY);
+        os << str;
+        flushNow(os);
+        ::SetConsoleTextAttribute(std_handle, old_color);
+#else
+        os << getColorEscape(c) << str << "\033[m";
+#endif
+    }
+
+    /***** escaping for machine-readable reports *****/
+
+    inline std::string escapeXml(const std::string& str) {
+        std::string out;
+        out.reserve(str.size());
+        for (std::size_t i = 0; i < str.size(); i++) {
+            const unsigned char c = static_cast<unsigned char>(str[i]);
+            switch (c) {
+            case '&':  out += "&amp;";  break;
+            case '<':  out += "&lt;";   break;
+            case '>':  out += "&gt;";   break;
+            case '"':  out += "&quot;"; break;
+            case '\'': out += "&apos;"; break;
+            default:
+                if (c < 0x20 && c != '\t' && c != '\n' && c != '\r') {
+                    char hex[8];
+                    snprintf(hex, sizeof(hex), "&#x%02x;", c);
+                    out += hex;
+                } else {
+                    out += static_cast<char>(c);
+                }
+            }
+        }
+        return out;
+    }
+
+    inline std::string escapeJson(const std::string& str) {
+        std::string out;
+        out.reserve(str.size());
+        for (std::size_t i = 0; i < str.size(); i++) {
+            const unsigned char c = static_cast<unsigned char>(str[i]);
+            switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (c < 0x20) {
+                    char hex[8];
+                    snprintf(hex, sizeof(hex), "\\u%04x", c);
+                    out += hex;
+                } else {
+                    out += static_cast<char>(c);
+                }
+            }
+        }
+        return out;
+    }
+
+    /***** bulk array comparison *****/
+
+    // each kernel counts the elements failing its scalar predicate:
+    //   eq   : !(e == a)
+    //   ulps : !Floating::almostEqual(e, a)
+    //   near : !(absDifference(e, a) <= abs_error)
+    // the SIMD loops agree with the scalar tails bit for bit, NaNs included.
+
+    inline std::size_t bitCount(unsigned v) {
+        std::size_t count = 0;
+        for (; v; v &= v - 1) count++;
+        return count;
+    }
+
+#ifdef PICOTEST_SSE2
+    // unsigned a > b, per 32-bit lane
+    inline __m128i cmpgtU32(__m128i a, __m128i b) {
+        const __m128i sign = _mm_set1_epi32(INT32_MIN);
+        return _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+    }
+
+    // unsigned a > b, per 64-bit lane (SSE2 has no 64-bit compare)
+    inline __m128i cmpgtU64(__m128i a, __m128i b) {
+        const __m128i gt = cmpgtU32(a, b);
+        const __m128i hi_eq = _mm_shuffle_epi32(_mm_cmpeq_epi32(a, b), _MM_SHUFFLE(3, 3, 1, 1));
+        const __m128i hi_gt = _mm_shuffle_epi32(gt, _MM_SHUFFLE(3, 3, 1, 1));
+        const __m128i lo_gt = _mm_shuffle_epi32(gt, _MM_SHUFFLE(2, 2, 0, 0));
+        return _mm_or_si128(hi_gt, _mm_and_si128(hi_eq, lo_gt));
+    }
+
+    // Floating::sam, per lane
+    inline __m128i sam32(__m128i bits) {
+        const __m128i negative = _mm_srai_epi32(bits, 31);
+        const __m128i neg = _mm_sub_epi32(_mm_setzero_si128(), bits);
+        const __m128i pos = _mm_or_si128(bits, _mm_set1_epi32(INT32_MIN));
+        return _mm_or_si128(_mm_and_si128(negative, neg), _mm_andnot_si128(negative, pos));
+    }
+
+    inline __m128i sam64(__m128i bits) {
+        const __m128i negative = _mm_shuffle_epi32(_mm_srai_epi32(bits, 31), _MM_SHUFFLE(3, 3, 1, 1));
+        const __m128i neg = _mm_sub_epi64(_mm_setzero_si128(), bits);
+        const __m128i pos = _mm_or_si128(bits, _mm_set1_epi64x(INT64_MIN));
+        return _mm_or_si128(_mm_and_si128(negative, neg), _mm_andnot_si128(negative, pos));
+    }
+
+    // Floating::distance(e, a) > max_ulps, per lane
+    inline __m128i ulpMismatch32(__m128i e, __m128i a, __m128i max_ulps) {
+        const __m128i se = sam32(e), sa = sam32(a);
+        const __m128i a_greater = cmpgtU32(sa, se);
+        const __m128i dist = _mm_or_si128(_mm_and_si128(a_greater, _mm_sub_epi32(sa, se)),
+                                          _mm_andnot_si128(a_greater, _mm_sub_epi32(se, sa)));
+        return cmpgtU32(dist, max_ulps);
+    }
+
+    inline __m128i ulpMismatch64(__m128i e, __m128i a, __m128i max_ulps) {
+        const __m128i se = sam64(e), sa = sam64(a);
+        const __m128i a_greater = cmpgtU64(sa, se);
+        const __m128i dist = _mm_or_si128(_mm_and_si128(a_greater, _mm_sub_epi64(sa, se)),
+                                          _mm_andnot_si128(a_greater, _mm_sub_epi64(se, sa)));
+        return cmpgtU64(dist, max_ulps);
+    }
+#endif // ifdef PICOTEST_SSE2
+
+#ifdef PICOTEST_AVX2
+    inline __m256i cmpgtU32(__m256i a, __m256i b) {
+        const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+        return _mm256_cmpgt_epi32(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+    }
+
+    inline __m256i cmpgtU64(__m256i a, __m256i b) {
+        const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+        return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+    }
+
+    inline __m256i sam32(__m256i bits) {
+        const __m256i negative = _mm256_srai_epi32(bits, 31);
+        const __m256i neg = _mm256_sub_epi32(_mm256_setzero_si256(), bits);
+        const __m256i pos = _mm256_or_si256(bits, _mm256_set1_epi32(INT32_MIN));
+        return _mm256_blendv_epi8(pos, neg, negative);
+    }
+
+    inline __m256i sam64(__m256i bits) {
+        const __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), bits);
+        const __m256i neg = _mm256_sub_epi64(_mm256_setzero_si256(), bits);
+        const __m256i pos = _mm256_or_si256(bits, _mm256_set1_epi64x(INT64_MIN));
+        return _mm256_blendv_epi8(pos, neg, negative);
+    }
+
+    inline __m256i ulpMismatch32(__m256i e, __m256i a, __m256i max_ulps) {
+        const __m256i se = sam32(e), sa = sam32(a);
+        const __m256i dist = _mm256_blendv_epi8(_mm256_sub_epi32(se, sa), _mm256_sub_epi32(sa, se), cmpgtU32(sa, se));
+        return cmpgtU32(dist, max_ulps);
+    }
+
+    inline __m256i ulpMismatch64(__m256i e, __m256i a, __m256i max_ulps) {
+        const __m256i se = sam64(e), sa = sam64(a);
+        const __m256i dist = _mm256_blendv_epi8(_mm256_sub_epi64(se, sa), _mm256_sub_epi64(sa, se), cmpgtU64(sa, se));
+        return cmpgtU64(dist, max_ulps);
+    }
+#endif // ifdef PICOTEST_AVX2
+
+    template<typename T1, typename T2>
+    std::size_t countEqMismatches(const T1* e, const T2* a, std::size_t n) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; i++)
+            if (!(e[i] == a[i])) count++;
+        return count;
+    }
+
+    // integers are equal exactly when their bytes are, so memcmp (already vectorized by libc) decides the passing case
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value, std::size_t>::type
+    countEqMismatches(const T* e, const T* a, std::size_t n) {
+        if (n == 0 || memcmp(e, a, n * sizeof(T)) == 0) return 0;
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; i++)
+            if (e[i] != a[i]) count++;
+        return count;
+    }
+
+    inline std::size_t countEqMismatches(const float* e, const float* a, std::size_t n) {
+        std::size_t i = 0, count = 0;
+#ifdef PICOTEST_AVX2
+        for (; i + 8 <= n; i += 8)
+            count += bitCount(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(e + i), _mm256_loadu_ps(a + i), _CMP_NEQ_UQ)));
+#endif
+#ifdef PICOTEST_SSE2
+        for (; i + 4 <= n; i += 4)
+            count += bitCount(_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(e + i), _mm_loadu_ps(a + i))));
+#endif
+        for (; i < n; i++)
+            if (!(e[i] == a[i])) count++;
+        return count;
+    }
+
+    inline std::size_t countEqMismatches(const double* e, const double* a, std::size_t n) {
+        std::size_t i = 0, count = 0;
+#ifdef PICOTEST_AVX2
+        for (; i + 4 <= n; i += 4)
+            count += bitCount(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(e + i), _mm256_loadu_pd(a + i), _CMP_NEQ_UQ)));
+#endif
+#ifdef PICOTEST_SSE2
+        for (; i + 2 <= n; i += 2)
+            count += bitCount(_mm_movemask_pd(_mm_cmpneq_pd(_mm_loadu_pd(e + i), _mm_loadu_pd(a + i))));
+#endif
+        for (; i < n; i++)
+            if (!(e[i] == a[i])) count++;
+        return count;
+    }
+
+    inline std::size_t countUlpMismatches(const float* e, const float* a, std::size_t n) {
+        std::size_t i = 0, count = 0;
+#ifdef PICOTEST_AVX2
+        const __m256i max_ulps8 = _mm256_set1_epi32(static_cast<int>(Floating::MIN_UPS));
+        for (; i + 8 <= n; i += 8) {
+            const __m256i bad = ulpMismatch32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(e + i)),
+                                              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), max_ulps8);
+            count += bitCount(_mm256_movemask_ps(_mm256_castsi256_ps(bad)));
+        }
+#endif
+#ifdef PICOTEST_SSE2
+        const __m128i max_ulps4 = _mm_set1_epi32(static_cast<int>(Floating::MIN_UPS));
+        for (; i + 4 <= n; i += 4) {
+            const __m128i bad = ulpMismatch32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(e + i)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), max_ulps4);
+            count += bitCount(_mm_movemask_ps(_mm_castsi128_ps(bad)));
+        }
+#endif
+        for (; i < n; i++)
+            if (!Floating::almostEqual(e[i], a[i])) count++;
+        return count;
+    }
+
+    inline std::size_t countUlpMismatches(const double* e, const double* a, std::size_t n) {
+        std::size_t i = 0, count = 0;
+#ifdef PICOTEST_AVX2
+        const __m256i max_ulps4 = _mm256_set1_epi64x(static_cast<int64_t>(Floating::MIN_UPS));
+        for (; i + 4 <= n; i += 4) {
+            const __m256i bad = ulpMismatch64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(e + i)),
+                                              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), max_ulps4);
+            count += bitCount(_mm256_movemask_pd(_mm256_castsi256_pd(bad)));
+        }
+#endif
+#ifdef PICOTEST_SSE2
+        const __m128i max_ulps2 = _mm_set1_epi64x(static_cast<int64_t>(Floating::MIN_UPS));
+        for (; i + 2 <= n; i += 2) {
+            const __m128i bad = ulpMismatch64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(e + i)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)), max_ulps2);
+            count += bitCount(_mm_movemask_pd(_mm_castsi128_pd(bad)));
+        }
+#endif
+        for (; i < n; i++)
+            if (!Floating::almostEqual(e[i], a[i])) count++;
+        return count;
+    }
+
+    template<typename T1, typename T2>
+    std::size_t countNearMismatches(const T1* e, const T2* a, std::size_t n, double abs_error) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; i++)
+            if (!(absDifference(e[i], a[i]) <= abs_error)) count++;
+        return count;
+    }
+
+    // the difference is taken in float and compared in double, as the scalar expression does
+    inline std::size_t countNearMismatches(const float* e, const float* a, std::size_t n, double abs_error) {
+        std::size_t i = 0, count = 0;
+#ifdef PICOTEST_AVX2
+        const __m256 sign8 = _mm256_set1_ps(-0.0f);
+        const __m256d tol4 = _mm256_set1_pd(abs_error);
+        for (; i + 8 <= n; i += 8) {
+            const __m256 diff = _mm256_andnot_ps(sign8, _mm256_sub_ps(_mm256_loadu_ps(e + i), _mm256_loadu_ps(a + i)));
+            const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(diff));
+            const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(diff, 1));
+            count += bitCount(_mm256_movemask_pd(_mm256_cmp_pd(lo, tol4, _CMP_NLE_UQ)));
+            count += bitCount(_mm256_movemask_pd(_mm256_cmp_pd(hi, tol4, _CMP_NLE_UQ)));
+        }
+#endif
+#ifdef PICOTEST_SSE2
+        const __m128 sign4 = _mm_set1_ps(-0.0f);
+        const __m128d tol2 = _mm_set1_pd(abs_error);
+        for (; i + 4 <= n; i += 4) {
+            const __m128 diff = _mm_andnot_ps(sign4, _mm_sub_ps(_mm_loadu_ps(e + i), _mm_loadu_ps(a + i)));
+            count += bitCount(_mm_movemask_pd(_mm_cmpnle_pd(_mm_cvtps_pd(diff), tol2)));
+            count += bitCount(_mm_movemask_pd(_mm_cmpnle_pd(_mm_cvtps_pd(_mm_movehl_ps(diff, diff)), tol2)));
+        }
+#endif
+        for (; i < n; i++)
+            if (!(std::abs(e[i] - a[i]) <= abs_error)) count++;
+        return count;
+    }
+
+    inline std::size_t countNearMismatches(const double* e, const double* a, std::size_t n, double abs_error) {
+        std::size_t i = 0, count = 0;
+#ifdef PICOTEST_AVX2
+        const __m256d sign4 = _mm256_set1_pd(-0.0);
+        const __m256d tol4 = _mm256_set1_pd(abs_error);
+        for (; i + 4 <= n; i += 4) {
+            const __m256d diff = _mm256_andnot_pd(sign4, _mm256_sub_pd(_mm256_loadu_pd(e + i), _mm256_loadu_pd(a + i)));
+            count += bitCount(_mm256_movemask_pd(_mm256_cmp_pd(diff, tol4, _CMP_NLE_UQ)));
+        }
+#endif
+#ifdef PICOTEST_SSE2
+        const __m128d sign2 = _mm_set1_pd(-0.0);
+        const __m128d tol2 = _mm_set1_pd(abs_error);
+        for (; i + 2 <= n; i += 2) {
+            const __m128d diff = _mm_andnot_pd(sign2, _mm_sub_pd(_mm_loadu_pd(e + i), _mm_loadu_pd(a + i)));
+            count += bitCount(_mm_movemask_pd(_mm_cmpnle_pd(diff, tol2)));
+        }
+#endif
+        for (; i < n; i++)
+            if (!(std::abs(e[i] - a[i]) <= abs_error)) count++;
+        return count;
+    }
+
+    // the failure path walks the arrays once more and describes at most this many mismatches
+    const std::size_t ARRAY_MISMATCHES_SHOWN = 10;
+
+    template<typename T>
+    std::string elementToString(const T& v) {
+        return toString(v);
+    }
+
+    inline std::string elementToString(float v) {
+        std::ostringstream os;
+        os << std::setprecision(9) << v;
+        return os.str();
+    }
+
+    inline std::string elementToString(double v) {
+        std::ostringstream os;
+        os << std::setprecision(17) << v;
+        return os.str();
+    }
+
+    template<typename T1, typename T2>
+    bool ulpDistance(const T1&, const T2&, uint64_t&) {
+        return false;
+    }
+
+    inline bool ulpDistance(float e, float a, uint64_t& ulps) {
+        ulps = Floating::ulps(e, a);
+        return true;
+    }
+
+    inline bool ulpDistance(double e, double a, uint64_t& ulps) {
+        ulps = Floating::ulps(e, a);
+        return true;
+    }
+
+    template<typename T1, typename T2>
+    double absError(const T1& e, const T2& a, std::true_type) {
+        return std::fabs(static_cast<double>(e) - static_cast<double>(a));
+    }
+
+    template<typename T1, typename T2>
+    double absError(const T1&, const T2&, std::false_type) {
+        return 0;
+    }
+
+    // "3 of 1000 elements differ (max 12 ULPs, max abs error 1.2e-06); first at [17] 1 vs 1.00000012, ..."
+    template<typename T1, typename T2, typename OP>
+    std::string describeArrayMismatches(const T1* e, const T2* a, std::size_t n, std::size_t mismatches, OP op) {
+        typedef std::integral_constant<bool, std::is_arithmetic<T1>::value && std::is_arithmetic<T2>::value> arithmetic;
+        std::ostringstream first;
+        std::size_t shown = 0;
+        double max_abs = 0;
+        uint64_t max_ulps = 0, ulps;
+        bool has_ulps = false;
+
+        for (std::size_t i = 0; i < n; i++) {
+            if (op(e[i], a[i])) continue;
+            if (shown < ARRAY_MISMATCHES_SHOWN)
+                first << (shown++ ? ", [" : "[") << i << "] " << elementToString(e[i]) << " vs " << elementToString(a[i]);
+            max_abs = std::max(max_abs, absError(e[i], a[i], arithmetic()));
+            if (ulpDistance(e[i], a[i], ulps)) {
+                max_ulps = std::max(max_ulps, ulps);
+                has_ulps = true;
+            }
+        }
+
+        std::ostringstream os;
+        os << mismatches << " of " << n << " elements differ";
+        if (arithmetic::value) {
+            os << " (";
+            if (has_ulps) os << "max " << max_ulps << " ULPs, ";
+            os << "max abs error " << max_abs << ")";
+        }
+        os << "; first at " << first.str();
+        if (mismatches > shown) os << ", ...";
+        return os.str();
+    }
+
+    /***** binary buffer comparison *****/
+
+    inline unsigned lowestBit(unsigned mask) {
+#if defined __GNUC__ || defined __clang__
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#elif defined _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        unsigned index = 0;
+        for (; !(mask & 1); mask >>= 1) index++;
+        return index;
+#endif
+    }
+
+    // index of the highest set bit; 'value' must not be 0
+    inline unsigned highestBit(uint64_t value) {
+#if defined __GNUC__ || defined __clang__
+        return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#elif defined _MSC_VER && defined _M_X64
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#else
+        unsigned index = 0;
+        while (value >>= 1) index++;
+        return index;
+#endif
+    }
+
+    // offset of the first differing byte in [from, n), or n if there is none
+    inline std::size_t findFirstDifference(const unsigned char* e, const unsigned char* a, std::size_t from, std::size_t n) {
+        std::size_t i = from;
+#ifdef PICOTEST_AVX2
+        // 64 bytes per step; the narrower loops below pinpoint the byte once a step differs
+        for (; i + 64 <= n; i += 64) {
+            const __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(e + i)),
+                                                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+            const __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(e + i + 32)),
+                                                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)));
+            if (_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1)) != -1) break;
+        }
+#endif
+#ifdef PICOTEST_SSE2
+        for (; i + 16 <= n; i += 16) {
+            const unsigned eq = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(e + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)))));
+            if (eq != 0xFFFF) return i + lowestBit(~eq & 0xFFFF);
+        }
+#endif
+        for (; i < n; i++)
+            if (e[i] != a[i]) return i;
+        return n;
+    }
+
+    // the failure path dumps this many windows of context around differences
+    const std::size_t MEM_DIFF_WINDOWS = 3;
+    const std::size_t MEM_DIFF_CONTEXT_ROWS = 1;
+
+    // 16 bytes per row, expected above actual, with differing bytes marked underneath:
+    //   00000ff0  e: 00 01 02 ...
+    //             a: 00 01 ff ...
+    //                      ^^
+    // e and a hold e_size and a_size bytes; past the end of one of them, the other's bytes count as differing.
+    // e[0] and a[0] are shown at offset 'origin'.
+    inline void hexdumpRows(std::ostream& os, const unsigned char* e, std::size_t e_size, const unsigned char* a,
+                            std::size_t a_size, std::size_t begin, std::size_t end, std::size_t origin = 0) {
+        static const char digits[] = "0123456789abcdef";
+
+        for (std::size_t row = begin; row < end; row += 16) {
+            std::string expected, actual, marks;
+            for (std::size_t i = row; i < row + 16 && i < end; i++) {
+                if (i < e_size) { expected += ' '; expected += digits[e[i] >> 4]; expected += digits[e[i] & 15]; }
+                else expected += "   ";
+                if (i < a_size) { actual += ' '; actual += digits[a[i] >> 4]; actual += digits[a[i] & 15]; }
+                else actual += "   ";
+                marks += i >= e_size || i >= a_size || e[i] != a[i] ? " ^^" : "   ";
+            }
+            os << "\n  " << std::hex << std::setw(8) << std::setfill('0') << origin + row << std::dec << "  e:" << expected
+               << "\n            a:" << actual;
+            if (marks.find('^') != std::string::npos)
+                os << "\n              " << marks.substr(0, marks.find_last_of('^') + 1);
+        }
+    }
+
+    // "3 of 65536 bytes differ, first at offset 0x1f4" followed by hexdump windows around the first differences
+    inline std::string describeMemMismatch(const unsigned char* e, const unsigned char* a, std::size_t n, std::size_t first) {
+        std::size_t count = 0;
+        for (std::size_t i = first; i < n; i++)
+            if (e[i] != a[i]) count++;
+
+        std::ostringstream os;
+        os << count << " of " << n << " bytes differ, first at offset 0x" << std::hex << first << std::dec;
+
+        const std::size_t context = MEM_DIFF_CONTEXT_ROWS * 16;
+        std::size_t diff = first;
+        for (std::size_t w = 0; w < MEM_DIFF_WINDOWS && diff < n; w++) {
+            const std::size_t begin = (diff > context ? diff - context : 0) & ~static_cast<std::size_t>(15);
+            const std::size_t end = std::min(n, ((diff + context) & ~static_cast<std::size_t>(15)) + 16);
+            hexdumpRows(os, e, n, a, n, begin, end);
+            diff = findFirstDifference(e, a, end, n);
+            if (diff < n) os << "\n  ...";
+        }
+        return os.str();
+    }
+
+    /***** golden files *****/
+
+    // golden files are compared GOLDEN_CHUNK bytes at a time
+    const std::size_t GOLDEN_CHUNK = 4 << 20;
+
+    // a failure shows the lines (or 16-byte rows) around the first difference, within this many bytes of it
+    const std::size_t GOLDEN_DIFF_WINDOW = 4096;
+    const std::size_t GOLDEN_CONTEXT_LINES = 2;
+    const std::size_t GOLDEN_LINE_WIDTH = 120;
+
+    // read-only view of a golden file: mapped where the platform allows, read into a buffer otherwise.
+    // a mapped chunk is released once it has been compared, so a file of many GB never stays resident.
+    class GoldenFile {
+    public:
+        explicit GoldenFile(const std::string& path) : exists_(false), size_(0), mapping_(0), file_(0), position_(0) {
+#if defined PICOTEST_POSIX
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0) {
+                exists_ = true;
+                size_ = static_cast<std::size_t>(st.st_size);
+                void* p = size_ > 0 ? ::mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+                if (p != MAP_FAILED) {
+                    mapping_ = static_cast<const unsigned char*>(p);
+                    ::madvise(p, size_, MADV_SEQUENTIAL);
+                }
+            }
+            ::close(fd);
+#elif defined PICOTEST_WINDOWS
+            const HANDLE handle = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                                                FILE_FLAG_SEQUENTIAL_SCAN, 0);
+            if (handle == INVALID_HANDLE_VALUE) return;
+            LARGE_INTEGER size;
+            if (::GetFileSizeEx(handle, &size)) {
+                exists_ = true;
+                size_ = static_cast<std::size_t>(size.QuadPart);
+                const HANDLE view = size_ > 0 ? ::CreateFileMappingA(handle, 0, PAGE_READONLY, 0, 0, 0) : 0;
+                if (view) {
+                    mapping_ = static_cast<const unsigned char*>(::MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+                    ::CloseHandle(view); // the view keeps the mapping alive
+                }
+            }
+            ::CloseHandle(handle);
+#endif
+            if (mapping_ || (exists_ && size_ == 0)) return;
+
+            // the size is already known, in 64 bits, wherever fstat or GetFileSizeEx is; ftell returns a long
+            file_ = fopen(path.c_str(), "rb");
+            if (!file_ || exists_) return;
+            exists_ = true;
+            fseek(file_, 0, SEEK_END);
+            size_ = static_cast<std::size_t>(ftell(file_));
+            fseek(file_, 0, SEEK_SET);
+        }
+
+        ~GoldenFile() {
+#if defined PICOTEST_POSIX
+            if (mapping_) ::munmap(const_cast<unsigned char*>(mapping_), size_);
+#elif defined PICOTEST_WINDOWS
+            if (mapping_) ::UnmapViewOfFile(mapping_);
+#endif
+            if (file_) fclose(file_);
+        }
+
+        bool exists() const {
+            return exists_;
+        }
+
+        // false for a file which exists but could be neither mapped nor opened
+        bool readable() const {
+            return mapping_ || file_ || size_ == 0;
+        }
+
+        std::size_t size() const {
+            return size_;
+        }
+
+        // the bytes [offset, offset + size) of the file, which must hold them; valid until the next call
+        const unsigned char* read(std::size_t offset, std::size_t size) {
+            if (mapping_) return mapping_ + offset;
+
+            buffer_.resize(std::max<std::size_t>(size, 1));
+            if (size == 0) return &buffer_[0]; // an empty file is neither mapped nor opened
+            if (offset != position_) seek(offset);
+            position_ = offset + fread(&buffer_[0], 1, size, file_);
+            return &buffer_[0];
+        }
+
+        // done with the bytes [offset, offset + size)
+        void release(std::size_t offset, std::size_t size) {
+#if defined PICOTEST_POSIX
+            if (!mapping_) return;
+            const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            const std::size_t begin = (offset + page - 1) / page * page;
+            const std::size_t end = (offset + size) / page * page;
+            if (begin < end) ::madvise(const_cast<unsigned char*>(mapping_) + begin, end - begin, MADV_DONTNEED);
+#else
+            (void)offset; (void)size;
+#endif
+        }
+
+        // offset of the first byte where the file and data[0..size) differ; the shorter length if one is
+        // a prefix of the other
+        std::size_t firstDifference(const unsigned char* data, std::size_t size) {
+            const std::size_t n = std::min(size, size_);
+            for (std::size_t offset = 0; offset < n; offset += GOLDEN_CHUNK) {
+                const std::size_t chunk = std::min(GOLDEN_CHUNK, n - offset);
+                const std::size_t diff = findFirstDifference(read(offset, chunk), data + offset, 0, chunk);
+                release(offset, chunk);
+                if (diff < chunk) return offset + diff;
+            }
+            return n;
+        }
+
+    private:
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(GoldenFile);
+
+        // beyond 2 GiB, where long is 32 bits (Windows, 32-bit POSIX built with _FILE_OFFSET_BITS=64)
+        void seek(std::size_t offset) {
+#if defined PICOTEST_POSIX
+            ::fseeko(file_, static_cast<off_t>(offset), SEEK_SET);
+#elif defined PICOTEST_WINDOWS
+            ::_fseeki64(file_, static_cast<__int64>(offset), SEEK_SET);
+#else
+            fseek(file_, static_cast<long>(offset), SEEK_SET);
+#endif
+        }
+
+        bool exists_;
+        std::size_t size_;
+        const unsigned char* mapping_;
+        FILE* file_; // when the file could not be mapped
+        std::size_t position_;
+        std::vector<unsigned char> buffer_;
+    };
+
+    // no control characters other than tabs and line breaks (UTF-8 passes)
+    inline bool looksLikeText(const std::string& bytes) {
+        for (std::size_t i = 0; i < bytes.size(); i++) {
+            const unsigned char c = static_cast<unsigned char>(bytes[i]);
+            if ((c < 0x20 && c != '\n' && c != '\r' && c != '\t') || c == 0x7f) return false;
+        }
+        return true;
+    }
+
+    // the lines of 'bytes' from offset 'begin' (on line number 'line', at column 'begin_column' of it) up to
+    // GOLDEN_CONTEXT_LINES past the one starting at 'diff_line', scrolled horizontally so that 'column' is in view
+    inline void textLines(std::ostream& os, const std::string& bytes, std::size_t begin, std::size_t begin_column,
+                          std::size_t line, std::size_t diff_line, std::size_t column, bool caret) {
+        const std::size_t scroll = column > GOLDEN_LINE_WIDTH / 2 ? column - GOLDEN_LINE_WIDTH / 2 : 0;
+        std::size_t after = 0;
+
+        for (std::size_t start = begin; start <= bytes.size() && after <= GOLDEN_CONTEXT_LINES; line++) {
+            if (start == bytes.size() && start != diff_line) break; // no line after the last line break
+
+            std::size_t end = bytes.find('\n', start);
+            if (end == std::string::npos) end = bytes.size();
+            std::string text = bytes.substr(start, end - start);
+            if (!text.empty() && text[text.size() - 1] == '\r') text.erase(text.size() - 1);
+            const std::size_t skip = start == begin && begin_column < scroll ? scroll - begin_column : scroll;
+            text = skip < text.size() ? text.substr(skip, GOLDEN_LINE_WIDTH) : std::string();
+
+            os << "\n    " << std::setw(6) << std::setfill(' ') << line << "  " << (scroll ? "..." : "") << text;
+            if (start == diff_line && caret) os << "\n            " << std::string(column - scroll + (scroll ? 3 : 0), ' ') << "^";
+            if (start >= diff_line) after++;
+            start = end + 1;
+        }
+    }
+
+    // where the golden file and the output differ, with the lines around it for text and a hexdump otherwise
+    inline std::string describeGoldenMismatch(GoldenFile& golden, const unsigned char* data, std::size_t size,
+                                              std::size_t first) {
+        std::ostringstream os;
+        os << "the golden file has " << golden.size() << " bytes, the output " << size << "; ";
+        if (first == golden.size()) os << "the golden file ends";
+        else if (first == size) os << "the output ends";
+        else os << "first difference";
+        os << " at offset 0x" << std::hex << first << std::dec;
+
+        // the bytes around the difference, from a 16-byte boundary
+        const std::size_t origin = (first - std::min(first, GOLDEN_DIFF_WINDOW)) & ~static_cast<std::size_t>(15);
+        const std::size_t golden_end = std::min(golden.size(), first + GOLDEN_DIFF_WINDOW);
+        const std::string expected(reinterpret_cast<const char*>(golden.read(origin, golden_end - origin)), golden_end - origin);
+        const std::string actual(reinterpret_cast<const char*>(data) + origin, std::min(size, first + GOLDEN_DIFF_WINDOW) - origin);
+        const std::size_t diff = first - origin;
+
+        if (looksLikeText(expected) && looksLikeText(actual)) {
+            // both sides hold the same bytes up to the difference; its line may start before the window
+            const unsigned char* line_start = data + first;
+            while (line_start > data && line_start[-1] != '\n') line_start--;
+            const std::size_t column = static_cast<std::size_t>(data + first - line_start);
+            const std::size_t diff_line = diff - std::min(diff, column);
+            std::size_t line = 1 + static_cast<std::size_t>(std::count(data, line_start, '\n'));
+            os << ", line " << line << ", column " << column + 1;
+            if ((diff < expected.size() && expected[diff] == '\r') || (diff < actual.size() && actual[diff] == '\r'))
+                os << " (line endings differ)";
+
+            std::size_t begin = diff_line, begin_column = column - (diff - diff_line);
+            for (std::size_t i = 0; i < GOLDEN_CONTEXT_LINES && begin > 0; i++, line--) {
+                const std::size_t previous = begin >= 2 ? actual.rfind('\n', begin - 2) : std::string::npos;
+                begin = previous == std::string::npos ? 0 : previous + 1;
+                begin_column = 0;
+            }
+            os << "\n  golden:";
+            textLines(os, expected, begin, begin_column, line, diff_line, column, false);
+            os << "\n  output:";
+            textLines(os, actual, begin, begin_column, line, diff_line, column, true);
+        } else {
+            const std::size_t context = MEM_DIFF_CONTEXT_ROWS * 16;
+            const std::size_t begin = (diff - std::min(diff, context)) & ~static_cast<std::size_t>(15);
+            const std::size_t end = std::min(std::max(expected.size(), actual.size()), ((diff + context) & ~static_cast<std::size_t>(15)) + 16);
+            hexdumpRows(os, reinterpret_cast<const unsigned char*>(expected.data()), expected.size(),
+                        reinterpret_cast<const unsigned char*>(actual.data()), actual.size(), begin, end, origin);
+        }
+        return os.str();
+    }
+
+    // renames 'from' over 'to', replacing it in one step
+    inline bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef PICOTEST_WINDOWS
+        return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return ::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+
+    // writes a temporary file next to 'path' and renames it over 'path', so that readers never see half of it
+    inline bool writeFileAtomically(const std::string& path, const void* data, std::size_t size) {
+        static std::atomic<unsigned> counter(0);
+#ifdef PICOTEST_POSIX
+        const std::string tmp = path + "." + toString(static_cast<long>(::getpid())) + "-" + toString(counter++) + ".tmp";
+#else
+        const std::string tmp = path + "." + toString(counter++) + ".tmp";
+#endif
+        FILE* file = fopen(tmp.c_str(), "wb");
+        if (!file) return false;
+        const bool written = fwrite(data, 1, size, file) == size;
+        if (fclose(file) != 0 || !written || !replaceFile(tmp, path)) {
+            remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /***** timing *****/
+
+    // time-stamp counter, or 0 where there is none
+    inline uint64_t readCycleCounter() {
+#if defined _MSC_VER && (defined _M_X64 || defined _M_IX86)
+        return __rdtsc();
+#elif (defined __GNUC__ || defined __clang__) && (defined __x86_64__ || defined __i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // CPU time consumed by the calling thread, or 0 where it cannot be measured
+    inline double threadCpuTimeNs() {
+#if defined PICOTEST_POSIX && defined CLOCK_THREAD_CPUTIME_ID
+        timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+#elif defined PICOTEST_WINDOWS
+        FILETIME creation, exit, kernel, user;
+        if (!::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+        const uint64_t k = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+        const uint64_t u = (static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+        return (k + u) * 100.0;
+#else
+        return 0;
+#endif
+    }
+
+    template<typename Rep, typename Period>
+    double toNanoseconds(const std::chrono::duration<Rep, Period>& d) {
+        return std::chrono::duration<double, std::nano>(d).count();
+    }
+
+    inline double toNanoseconds(double ns) {
+        return ns;
+    }
+
+    inline std::string formatDuration(double ns) {
+        std::ostringstream os;
+        os << std::setprecision(3) << std::fixed;
+        if      (ns < 1e3) os << ns << " ns";
+        else if (ns < 1e6) os << ns / 1e3 << " us";
+        else if (ns < 1e9) os << ns / 1e6 << " ms";
+        else               os << ns / 1e9 << " s";
+        return os.str();
+    }
+
+    // 12.3M/s
+    inline std::string formatRate(double per_second) {
+        std::ostringstream os;
+        os << std::setprecision(1) << std::fixed;
+        if      (per_second < 1e3) os << per_second << "/s";
+        else if (per_second < 1e6) os << per_second / 1e3 << "k/s";
+        else if (per_second < 1e9) os << per_second / 1e6 << "M/s";
+        else                       os << per_second / 1e9 << "G/s";
+        return os.str();
+    }
+
+    /***** threads *****/
+
+    // hint to the CPU that the caller is spinning
+    inline void cpuRelax() {
+#if defined _MSC_VER && (defined _M_X64 || defined _M_IX86)
+        _mm_pause();
+#elif (defined __GNUC__ || defined __clang__) && (defined __x86_64__ || defined __i386__)
+        __builtin_ia32_pause();
+#elif (defined __GNUC__ || defined __clang__) && defined __aarch64__
+        asm volatile("yield");
+#endif
+    }
+
+    // binds the calling thread to one CPU. returns false where that is not supported (Linux only)
+    inline bool pinThread(unsigned cpu) {
+#ifdef PICOTEST_LINUX
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    // releases 'count' threads at once. they spin rather than sleep, so that none of them
+    // waits for a wake-up; a spinner yields now and then in case there are fewer CPUs than threads
+    class SpinBarrier {
+    public:
+        explicit SpinBarrier(std::size_t count) : count_(count), arrived_(0) {}
+
+        void wait() {
+            arrived_.fetch_add(1, std::memory_order_acq_rel);
+            for (unsigned spins = 1; arrived_.load(std::memory_order_acquire) < count_; spins++) {
+                if (spins % 1024 == 0) std::this_thread::yield();
+                else cpuRelax();
+            }
+        }
+
+    private:
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(SpinBarrier);
+
+        const std::size_t count_;
+        std::atomic<std::size_t> arrived_;
+    };
+
+    /***** hardware performance counters *****/
+
+    enum PerfCounter {
+        PerfCycles,
+        PerfInstructions,
+        PerfBranchMisses,
+        PerfL1dMisses,
+        PerfLlcMisses,
+        PerfPageFaults,
+        PerfContextSwitches,
+        PerfCounterCount
+    };
+
+    inline const char* perfCounterName(int counter) {
+        static const char* const names[PerfCounterCount] = {
+            "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "page-faults", "context-switches"
+        };
+        return names[counter];
+    }
+
+    // counter values; a counter the system cannot provide is missing from 'available'
+    struct PerfCounts {
+        PerfCounts() : available(0) {
+            std::fill(values, values + PerfCounterCount, 0.0);
+        }
+
+        bool has(int counter) const {
+            return (available >> counter) & 1;
+        }
+
+        // the counts between two readings, e.g. per iteration when divided by the iteration count
+        PerfCounts since(const PerfCounts& start, double divisor = 1) const {
+            PerfCounts d;
+            d.available = available & start.available;
+            for (int c = 0; c < PerfCounterCount; c++)
+                if (d.has(c)) d.values[c] = (values[c] - start.values[c]) / divisor;
+            return d;
+        }
+
+        double values[PerfCounterCount];
+        unsigned available;
+    };
+
+    // counters of the calling thread (and of threads it starts afterwards, once they exit), via
+    // perf_event_open. hardware events the kernel refuses (perf_event_paranoid, containers, VMs
+    // without a PMU) are dropped; page faults and context switches then come from getrusage.
+    // the counters run freely and are read twice, so measurements can nest.
+    class PerfCounterGroup {
+    public:
+        static PerfCounterGroup& forThisThread() {
+            static thread_local PerfCounterGroup group;
+            return group;
+        }
+
+        PerfCounts read() const {
+            PerfCounts counts;
+#ifdef PICOTEST_LINUX
+            for (int c = 0; c < PerfCounterCount; c++) {
+                uint64_t v[3]; // value, time enabled, time running
+                if (fds_[c] < 0 || ::read(fds_[c], v, sizeof(v)) != static_cast<ssize_t>(sizeof(v))) continue;
+                counts.values[c] = v[2] > 0 && v[2] < v[1] ? static_cast<double>(v[0]) * v[1] / v[2] : static_cast<double>(v[0]);
+                counts.available |= 1u << c;
+            }
+
+            rusage usage;
+            if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+                if (!counts.has(PerfPageFaults)) {
+                    counts.values[PerfPageFaults] = static_cast<double>(usage.ru_minflt + usage.ru_majflt);
+                    counts.available |= 1u << PerfPageFaults;
+                }
+                if (!counts.has(PerfContextSwitches)) {
+                    counts.values[PerfContextSwitches] = static_cast<double>(usage.ru_nvcsw + usage.ru_nivcsw);
+                    counts.available |= 1u << PerfContextSwitches;
+                }
+            }
+#endif
+            return counts;
+        }
+
+    private:
+        PerfCounterGroup() {
+            std::fill(fds_, fds_ + PerfCounterCount, -1);
+#ifdef PICOTEST_LINUX
+            open(PerfCycles,          PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            open(PerfInstructions,    PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+            open(PerfBranchMisses,    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+            open(PerfL1dMisses,       PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            open(PerfLlcMisses,       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+            open(PerfPageFaults,      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+            open(PerfContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+#endif
+        }
+
+        ~PerfCounterGroup() {
+#ifdef PICOTEST_LINUX
+            for (int c = 0; c < PerfCounterCount; c++)
+                if (fds_[c] >= 0) ::close(fds_[c]);
+#endif
+        }
+
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(PerfCounterGroup);
+
+#ifdef PICOTEST_LINUX
+        void open(int counter, uint32_t type, uint64_t config) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds_[counter] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        }
+#endif
+
+        int fds_[PerfCounterCount];
+    };
+
+    inline std::string formatCount(double count) {
+        std::ostringstream os;
+        if (count >= 1e9)      os << std::setprecision(3) << count / 1e9 << "G";
+        else if (count >= 1e6) os << std::setprecision(3) << count / 1e6 << "M";
+        else if (count >= 1e4) os << std::setprecision(3) << count / 1e3 << "k";
+        else                   os << std::setprecision(4) << count;
+        return os.str();
+    }
+
+    // "1.23M cycles, 2.5M instructions, ..."
+    inline std::string formatPerfCounts(const PerfCounts& counts) {
+        std::string str;
+        for (int c = 0; c < PerfCounterCount; c++) {
+            if (!counts.has(c)) continue;
+            if (!str.empty()) str += ", ";
+            str += formatCount(counts.values[c]) + " " + perfCounterName(c);
+        }
+        return str;
+    }
+
+    /***** statistics *****/
+
+    // one-sided Mann-Whitney U test: the probability of seeing samples of 'b' this much larger than
+    // those of 'a' if both came from the same distribution (normal approximation with tie correction)
+    inline double mannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b) {
+        const double na = static_cast<double>(a.size()), nb = static_cast<double>(b.size()), n = na + nb;
+        if (a.empty() || b.empty()) return 1;
+
+        std::vector<std::pair<double, bool> > all; // value, belongs to b
+        for (std::size_t i = 0; i < a.size(); i++) all.push_back(std::make_pair(a[i], false));
+        for (std::size_t i = 0; i < b.size(); i++) all.push_back(std::make_pair(b[i], true));
+        std::sort(all.begin(), all.end());
+
+        double rank_sum_b = 0, ties = 0;
+        for (std::size_t i = 0; i < all.size(); ) {
+            std::size_t j = i;
+            while (j < all.size() && all[j].first == all[i].first) j++;
+            const double rank = (i + 1 + j) / 2.0, t = static_cast<double>(j - i);
+            for (std::size_t k = i; k < j; k++)
+                if (all[k].second) rank_sum_b += rank;
+            ties += t * t * t - t;
+            i = j;
+        }
+
+        const double u = rank_sum_b - nb * (nb + 1) / 2;
+        const double mean = na * nb / 2;
+        const double variance = na * nb / 12 * ((n + 1) - ties / (n * (n - 1)));
+        if (variance <= 0) return 1;
+
+        const double z = (u - mean - 0.5) / std::sqrt(variance);
+        return 0.5 * std::erfc(z / std::sqrt(2.0));
+    }
+
+    inline double median(std::vector<double> v) {
+        if (v.empty()) return 0;
+        std::sort(v.begin(), v.end());
+        const std::size_t n = v.size();
+        return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+    }
+
+#ifndef __GNUC__
+    inline void useCharPointer(char const volatile* p) {
+        static char const volatile* volatile sink;
+        sink = p;
+    }
+#endif
+
+    /***** work-stealing scheduler *****/
+
+    // the block of indices [begin, end) a worker still has to run, packed into a single word so that the
+    // owner and the thieves claim indices with one compare-and-swap each, without a lock
+    class StealableRange {
+    public:
+        StealableRange() : range_(0) {}
+
+        void assign(std::size_t begin, std::size_t end) {
+            range_.store(pack(begin, end), std::memory_order_relaxed);
+        }
+
+        // the owner consumes from the front to keep registration order...
+        bool pop(std::size_t& task) {
+            uint64_t r = range_.load(std::memory_order_relaxed);
+            do {
+                if (first(r) == last(r)) return false;
+                task = first(r);
+            } while (!range_.compare_exchange_weak(r, pack(first(r) + 1, last(r)), std::memory_order_relaxed));
+            return true;
+        }
+
+        // ...and thieves take from the back, the part the owner would reach last
+        bool steal(std::size_t& task) {
+            uint64_t r = range_.load(std::memory_order_relaxed);
+            do {
+                if (first(r) == last(r)) return false;
+                task = last(r) - 1;
+            } while (!range_.compare_exchange_weak(r, pack(first(r), last(r) - 1), std::memory_order_relaxed));
+            return true;
+        }
+
+    private:
+        static uint64_t pack(std::size_t begin, std::size_t end) {
+            return (static_cast<uint64_t>(begin) << 32) | static_cast<uint32_t>(end);
+        }
+        static std::size_t first(uint64_t r) { return static_cast<std::size_t>(r >> 32); }
+        static std::size_t last(uint64_t r) { return static_cast<std::size_t>(r & 0xffffffffu); }
+
+        // the indices are only claimed here; what f(i) writes is published by joining the threads
+        std::atomic<uint64_t> range_;
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(StealableRange);
+    };
+
+    inline std::size_t resolveJobs(std::size_t jobs) {
+        if (jobs == 0) jobs = std::thread::hardware_concurrency();
+        return jobs == 0 ? 1 : jobs;
+    }
+
+    // calls f(0) ... f(n-1) on 'jobs' threads (the calling thread included).
+    // each worker owns a contiguous block of indices and steals from the others when it runs dry.
+    template<typename Func>
+    void parallelFor(std::size_t n, std::size_t jobs, Func f) {
+        jobs = std::min(resolveJobs(jobs), n);
+
+        if (jobs <= 1) {
+            for (std::size_t i = 0; i < n; i++) f(i);
+            return;
+        }
+
+        std::vector<StealableRange> queues(jobs);
+        for (std::size_t w = 0; w < jobs; w++)
+            queues[w].assign(w * n / jobs, (w + 1) * n / jobs);
+
+        auto worker = [&](std::size_t self) {
+            std::size_t task;
+            for (;;) {
+                bool found = queues[self].pop(task);
+                for (std::size_t k = 1; !found && k < jobs; k++)
+                    found = queues[(self + k) % jobs].steal(task);
+                if (!found) return; // no task is ever added while running, so we are done
+                f(task);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (std::size_t w = 1; w < jobs; w++)
+            threads.push_back(std::thread(worker, w));
+        worker(0);
+        std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+    }
+
+    /***** shuffling *****/
+
+    // Fisher-Yates driven by std::mt19937 directly: unlike std::shuffle, the result is the same with
+    // every standard library, so a printed seed reproduces the order anywhere
+    template<typename T>
+    void shuffle(std::vector<T>& v, std::mt19937& rng) {
+        for (std::size_t i = v.size(); i > 1; i--)
+            std::swap(v[i - 1], v[rng() % i]);
+    }
+
+    // in [1, 99999] like googletest's, so it is short enough to retype
+    inline uint32_t makeRandomSeed() {
+        return static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count() % 99999) + 1;
+    }
+
+    /***** command line *****/
+
+    // matches "--flag=value" (or a bare "--flag", which yields an empty value)
+    inline bool parseFlag(const char* arg, const char* flag, std::string& value) {
+        const std::size_t len = strlen(flag);
+        if (strncmp(arg, "--", 2) != 0 || strncmp(arg + 2, flag, len) != 0) return false;
+
+        const char* rest = arg + 2 + len;
+        if (*rest == '\0') {
+            value.clear();
+            return true;
+        }
+        if (*rest != '=') return false;
+        value = rest + 1;
+        return true;
+    }
+
+    // a bare flag means "true"
+    inline bool parseBool(const std::string& value) {
+        return value.empty() || value == "1" || value == "true" || value == "yes";
+    }
+
+    /***** sharding *****/
+
+    // reads PICOTEST_TOTAL_SHARDS/PICOTEST_SHARD_INDEX, falling back to the googletest names
+    inline bool getShard(std::size_t& index, std::size_t& total) {
+        const char* total_str = getenv("PICOTEST_TOTAL_SHARDS");
+        const char* index_str = getenv("PICOTEST_SHARD_INDEX");
+
+        if (!total_str || !index_str) {
+            total_str = getenv("GTEST_TOTAL_SHARDS");
+            index_str = getenv("GTEST_SHARD_INDEX");
+        }
+        if (!total_str || !index_str) return false;
+
+        const int t = atoi(total_str), i = atoi(index_str);
+        if (t <= 0 || i < 0 || i >= t) return false;
+
+        // tell the launcher that sharding is supported, as googletest does
+        if (const char* status_file = getenv("GTEST_SHARD_STATUS_FILE")) {
+            if (FILE* fp = fopen(status_file, "w")) fclose(fp);
+        }
+
+        index = static_cast<std::size_t>(i);
+        total = static_cast<std::size_t>(t);
+        return true;
+    }
+
+    /***** test filter *****/
+
+    // '*' matches any string, '?' any single character
+    inline bool globMatch(const char* pattern, const char* str) {
+        const char* star = 0;
+        const char* backtrack = 0;
+
+        while (*str) {
+            if (*pattern == '?' || *pattern == *str) {
+                pattern++;
+                str++;
+            } else if (*pattern == '*') {
+                star = pattern++;
+                backtrack = str;
+            } else if (star) {
+                pattern = star + 1;
+                str = ++backtrack;
+            } else {
+                return false;
+            }
+        }
+        while (*pattern == '*') pattern++;
+        return *pattern == '\0';
+    }
+
+    // googletest syntax: "POSITIVE[:POSITIVE...][-NEGATIVE[:NEGATIVE...]]", matched against "TestCase.Test".
+    // the patterns are classified once, so that the common exact/prefix forms avoid the glob matcher.
+    class TestFilter {
+    public:
+        explicit TestFilter(const std::string& filter) {
+            const std::string::size_type minus = filter.find('-');
+            split(filter.substr(0, minus), positive_);
+            if (minus != std::string::npos) split(filter.substr(minus + 1), negative_);
+        }
+
+        bool matchesAll() const {
+            return positive_.empty() && negative_.empty();
+        }
+
+        bool match(const std::string& full_name) const {
+            return (positive_.empty() || matchAny(positive_, full_name)) && !matchAny(negative_, full_name);
+        }
+
+        // for an instance of a TEST_P, which is also known by the name of the test standing for it ("Name/0..99")
+        bool match(const std::string& full_name, const std::string& group_name) const {
+            return (positive_.empty() || matchAny(positive_, full_name) || matchAny(positive_, group_name)) &&
+                   !matchAny(negative_, full_name) && !matchAny(negative_, group_name);
+        }
+
+    private:
+        struct Pattern {
+            enum Kind { Exact, Prefix, Glob, Any };
+
+            explicit Pattern(const std::string& pattern) : text(pattern), kind(Glob) {
+                const std::string::size_type wildcard = pattern.find_first_of("*?");
+                if (pattern == "*")
+                    kind = Any;
+                else if (wildcard == std::string::npos)
+                    kind = Exact;
+                else if (wildcard == pattern.size() - 1 && pattern[wildcard] == '*') {
+                    kind = Prefix;
+                    text.erase(wildcard);
+                }
+            }
+
+            bool match(const std::string& str) const {
+                switch (kind) {
+                case Exact:  return str == text;
+                case Prefix: return str.compare(0, text.size(), text) == 0;
+                case Any:    return true;
+                default:     return globMatch(text.c_str(), str.c_str());
+                }
+            }
+
+            std::string text;
+            Kind kind;
+        };
+
+        static void split(const std::string& patterns, std::vector<Pattern>& out) {
+            std::string::size_type begin = 0;
+            while (begin <= patterns.size()) {
+                std::string::size_type end = patterns.find(':', begin);
+                if (end == std::string::npos) end = patterns.size();
+                if (end > begin) out.push_back(Pattern(patterns.substr(begin, end - begin)));
+                begin = end + 1;
+            }
+        }
+
+        static bool matchAny(const std::vector<Pattern>& patterns, const std::string& str) {
+            for (std::size_t i = 0; i < patterns.size(); i++)
+                if (patterns[i].match(str)) return true;
+            return false;
+        }
+
+        std::vector<Pattern> positive_;
+        std::vector<Pattern> negative_;
+    };
+
+    /***** allocation tracking *****/
+
+    // set by the translation unit defining PICOTEST_TRACK_ALLOCATIONS, which replaces operator new/delete
+    inline bool& allocationTrackingEnabled() {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    // allocations made by the calling thread, for EXPECT_NO_ALLOC/EXPECT_MAX_ALLOCS scopes
+    struct ThreadAllocations {
+        uint64_t count;
+        uint64_t bytes;
+        int paused;
+    };
+
+    inline ThreadAllocations& threadAllocations() {
+        static thread_local ThreadAllocations allocations = { 0, 0, 0 };
+        return allocations;
+    }
+
+    // allocations made by the framework itself (e.g. storing a failure) are not charged to the test
+    class AllocationTrackingPause {
+    public:
+        AllocationTrackingPause() { threadAllocations().paused++; }
+        ~AllocationTrackingPause() { threadAllocations().paused--; }
+    private:
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(AllocationTrackingPause);
+    };
+
+#ifdef PICOTEST_BACKTRACE
+    /***** backtraces of hung tests *****/
+
+    // makes the receiving thread print its own backtrace to stderr
+    const int BACKTRACE_SIGNAL = SIGUSR2;
+
+    inline std::atomic<int>& backtracesPrinted() {
+        static std::atomic<int> printed(0);
+        return printed;
+    }
+
+    inline void backtraceHandler(int) {
+        void* frames[64];
+        const int n = backtrace(frames, 64);
+        backtrace_symbols_fd(frames, n, 2);
+        backtracesPrinted()++;
+    }
+
+    inline void installBacktraceHandler() {
+        void* frame;
+        backtrace(&frame, 1); // loads the unwinder now; it would allocate inside the handler otherwise
+        backtracesPrinted();
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = backtraceHandler;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(BACKTRACE_SIGNAL, &action, 0);
+    }
+
+    // asks a thread of this process for its backtrace and waits (up to a second) until it is printed
+    inline void printBacktrace(pthread_t thread) {
+        const int printed = backtracesPrinted();
+        if (pthread_kill(thread, BACKTRACE_SIGNAL) != 0) return;
+        for (int i = 0; i < 100 && backtracesPrinted() == printed; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+#endif
+
+#ifdef PICOTEST_POSIX
+    /***** inter-process messages *****/
+
+    inline bool writeAll(int fd, const void* data, std::size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            const ssize_t n = ::write(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    inline bool readAll(int fd, void* data, std::size_t size) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            const ssize_t n = ::read(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    // messages are length-prefixed and written with a single call
+    inline bool writeMessage(int fd, const std::string& payload) {
+        const uint32_t size = static_cast<uint32_t>(payload.size());
+        std::string buf(reinterpret_cast<const char*>(&size), sizeof(size));
+        buf += payload;
+        return writeAll(fd, buf.data(), buf.size());
+    }
+
+    inline bool readMessage(int fd, std::string& payload) {
+        uint32_t size;
+        if (!readAll(fd, &size, sizeof(size))) return false;
+        payload.resize(size);
+        return size == 0 || readAll(fd, &payload[0], size);
+    }
+
+    class MessageWriter {
+    public:
+        void put(uint32_t v) {
+            buf_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+
+        void put(double v) {
+            buf_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+
+        void put(const std::string& str) {
+            put(static_cast<uint32_t>(str.size()));
+            buf_ += str;
+        }
+
+        const std::string& str() const {
+            return buf_;
+        }
+
+    private:
+        std::string buf_;
+    };
+
+    class MessageReader {
+    public:
+        explicit MessageReader(const std::string& buf) : buf_(buf), pos_(0) {}
+
+        bool get(uint32_t& v) {
+            if (buf_.size() - pos_ < sizeof(v)) return false;
+            memcpy(&v, buf_.data() + pos_, sizeof(v));
+            pos_ += sizeof(v);
+            return true;
+        }
+
+        bool get(double& v) {
+            if (buf_.size() - pos_ < sizeof(v)) return false;
+            memcpy(&v, buf_.data() + pos_, sizeof(v));
+            pos_ += sizeof(v);
+            return true;
+        }
+
+        bool get(std::string& str) {
+            uint32_t size;
+            if (!get(size) || buf_.size() - pos_ < size) return false;
+            str.assign(buf_, pos_, size);
+            pos_ += size;
+            return true;
+        }
+
+    private:
+        const std::string& buf_;
+        std::size_t pos_;
+    };
+
+    inline std::string describeExitStatus(int status) {
+        std::ostringstream os;
+        if (WIFSIGNALED(status))
+            os << "worker process killed by signal " << WTERMSIG(status) << " (" << static_cast<const char*>(strsignal(WTERMSIG(status))) << ")";
+        else if (WIFEXITED(status))
+            os << "worker process exited with status " << WEXITSTATUS(status);
+        else
+            os << "worker process terminated abnormally";
+        return os.str();
+    }
+#endif
+}
+
+/////////////////////////////////////////////////////////////////
+// framework
+
+namespace framework {
+
+class  TestCase;
+class  Test;
+struct Registry;
+struct Failure;
+class  FailureCapture;
+
+enum TestReportMode {
+    TestReportOnlyFailure,
+    TestReportForEach
+};
+
+enum TestFlags {
+    TestFlagSerial = 1,   // never runs concurrently with other tests (e.g. benchmarks)
+    TestFlagCoroutine = 2 // a CO_TEST, interleaved with the others on the event loop
+};
+
+// what the test is in the middle of (e.g. which parameter it runs with); prefixed to the failures
+// recorded meanwhile on the thread which set it
+class FailureContext {
+public:
+    virtual ~FailureContext() {}
+    virtual std::string describe() const = 0;
+};
+
+// the settings of a run, mostly set from the command line (see RUN_ALL_TESTS(argc, argv)); the accessors of
+// TestState document each of them
+struct Options {
+    Options()
+        : report_mode(TestReportForEach),
+          jobs(1),
+          process_isolation(false),
+          benchmark_samples(10),
+          benchmark_min_time_ms(10),
+          slowest_tests(0),
+          print_time(false),
+          time_budget_ms(0),
+          timeout_ms(0),
+          leak_check(false),
+          perf_counters(false),
+          stress_pin_threads(false),
+          property_cases(1000),
+          property_threads(1),
+          fake_clock(false),
+          max_failures(100),
+          shuffle(false),
+          random_seed(0),
+          repeat(0),
+          repeat_until_fail(false),
+          baseline_path("picotest.baseline"),
+          compare_baselines(false),
+          update_baselines(false),
+          baseline_tolerance(0.05),
+          update_goldens(false) {}
+
+    TestReportMode report_mode;
+    std::size_t jobs;
+    bool process_isolation;
+    std::size_t benchmark_samples;
+    double benchmark_min_time_ms;
+    std::size_t slowest_tests;
+    bool print_time;
+    double time_budget_ms;
+    double timeout_ms;
+    bool leak_check;
+    bool perf_counters;
+    bool stress_pin_threads;
+    std::size_t property_cases;
+    std::size_t property_threads;
+    bool fake_clock;
+    std::size_t max_failures;
+    bool shuffle;
+    uint32_t random_seed;
+    std::size_t repeat;
+    bool repeat_until_fail;
+    std::string baseline_path;
+    bool compare_baselines;
+    bool update_baselines;
+    double baseline_tolerance;
+    bool update_goldens;
+    std::string filter;
+};
+
+// current test/testcase are tracked per thread, so that tests can run in parallel.
+// threads which never started a test (e.g. ones spawned by a test body) and did not adopt one (see AdoptTest)
+// are bound to the test running when they first fail, until that test ends (see framework::threadFailures).
+struct TestState {
+    TestState() {}
+
+    static TestState& getInstance() {
+        static TestState instance;
+        return instance;
+    }
+
+    static TestCase* getCurrentTestCase() {
+        TestCase* testcase = threadTestCase();
+        return testcase ? testcase : lastTestCase().load();
+    }
+
+    static Test* getCurrentTest() {
+        Test* test = threadTest();
+        if (!test) test = adoptedTest();
+        return test ? test : lastTest().load();
+    }
+
+    // false on threads spawned by a test body, as opposed to the thread running the test
+    static bool onTestThread() {
+        return threadTest() != 0;
+    }
+
+    // the test a spawned thread reports to (see AdoptTest); 0 = the most recently started one
+    static void setAdoptedTest(Test* test) {
+        adoptedTest() = test;
+    }
+
+    static Test* getAdoptedTest() {
+        return adoptedTest();
+    }
+
+    // number of test bodies running, on any thread; constant-initialized like lastTest
+    static std::atomic<int>& runningTests() {
+        static std::atomic<int> n(0);
+        return n;
+    }
+
+    static const FailureContext* getFailureContext() {
+        return failureContext();
+    }
+
+    static void setFailureContext(const FailureContext* context) {
+        failureContext() = context;
+    }
+
+    // set while the calling thread only checks whether assertions fail (see FailureCapture)
+    static FailureCapture* getFailureCapture() {
+        return failureCapture();
+    }
+
+    static void setFailureCapture(FailureCapture* capture) {
+        failureCapture() = capture;
+    }
+
+    static void setCurrentTestCase(TestCase* testcase) {
+        threadTestCase() = testcase;
+        lastTestCase() = testcase;
+    }
+
+    static void setCurrentTest(Test* test) {
+        threadTest() = test;
+        lastTest() = test;
+    }
+
+    static TestReportMode getReportMode() {
+        return getInstance().options_.report_mode;
+    }
+
+    static void setReportMode(TestReportMode mode) {
+        getInstance().options_.report_mode = mode;
+    }
+
+    // number of worker threads used by Registry::testRun (0 = one per hardware thread)
+    static std::size_t getJobs() {
+        return getInstance().options_.jobs;
+    }
+
+    static void setJobs(std::size_t jobs) {
+        getInstance().options_.jobs = jobs;
+    }
+
+    // run each test in a pool of forked worker processes (POSIX only), so that a crash fails only that test
+    static bool getProcessIsolation() {
+        return getInstance().options_.process_isolation;
+    }
+
+    static void setProcessIsolation(bool isolation) {
+        getInstance().options_.process_isolation = isolation;
+    }
+
+    // number of timed samples taken by each BENCHMARK
+    static std::size_t getBenchmarkSamples() {
+        return getInstance().options_.benchmark_samples;
+    }
+
+    static void setBenchmarkSamples(std::size_t samples) {
+        getInstance().options_.benchmark_samples = samples > 0 ? samples : 1;
+    }
+
+    // minimum duration of one sample; the iteration count is scaled up until it is reached
+    static double getBenchmarkMinTimeMs() {
+        return getInstance().options_.benchmark_min_time_ms;
+    }
+
+    static void setBenchmarkMinTimeMs(double ms) {
+        getInstance().options_.benchmark_min_time_ms = ms;
+    }
+
+    // number of entries in the "slowest tests" table printed by Registry::report (0 = none)
+    static std::size_t getSlowestTests() {
+        return getInstance().options_.slowest_tests;
+    }
+
+    static void setSlowestTests(std::size_t n) {
+        getInstance().options_.slowest_tests = n;
+    }
+
+    // whether each testcase line of the report shows its wall-clock and CPU time
+    static bool getPrintTime() {
+        return getInstance().options_.print_time;
+    }
+
+    static void setPrintTime(bool print_time) {
+        getInstance().options_.print_time = print_time;
+    }
+
+    // googletest-style filter, see detail::TestFilter (empty = run everything)
+    static const std::string& getFilter() {
+        return getInstance().options_.filter;
+    }
+
+    static void setFilter(const std::string& filter) {
+        getInstance().options_.filter = filter;
+    }
+
+    // wall time a single test may take before it is failed (0 = unlimited; benchmarks are exempt)
+    static double getTimeBudgetMs() {
+        return getInstance().options_.time_budget_ms;
+    }
+
+    static void setTimeBudgetMs(double ms) {
+        getInstance().options_.time_budget_ms = ms;
+    }
+
+    // wall time after which a test is considered hung and the watchdog steps in (0 = never;
+    // TEST_TIMEOUT overrides it per test)
+    static double getTimeoutMs() {
+        return getInstance().options_.timeout_ms;
+    }
+
+    static void setTimeoutMs(double ms) {
+        getInstance().options_.timeout_ms = ms;
+    }
+
+    // run the testcases, and the tests within each, in random order
+    static bool getShuffle() {
+        return getInstance().options_.shuffle;
+    }
+
+    static void setShuffle(bool shuffle) {
+        getInstance().options_.shuffle = shuffle;
+    }
+
+    // seed of the first iteration; iteration i uses seed + i (0 = pick one, which is printed)
+    static uint32_t getRandomSeed() {
+        return getInstance().options_.random_seed;
+    }
+
+    static void setRandomSeed(uint32_t seed) {
+        getInstance().options_.random_seed = seed;
+    }
+
+    // number of times the selected tests are run; with getRepeatUntilFail(), the maximum. 0 = not given:
+    // once, or without limit with getRepeatUntilFail()
+    static std::size_t getRepeat() {
+        return getInstance().options_.repeat;
+    }
+
+    static void setRepeat(std::size_t repeat) {
+        getInstance().options_.repeat = repeat;
+    }
+
+    // repeat the run until an iteration fails, running iterations in parallel processes where possible
+    static bool getRepeatUntilFail() {
+        return getInstance().options_.repeat_until_fail;
+    }
+
+    static void setRepeatUntilFail(bool until_fail) {
+        getInstance().options_.repeat_until_fail = until_fail;
+    }
+
+    // fail tests which return without freeing what they allocated (needs PICOTEST_TRACK_ALLOCATIONS)
+    static bool getLeakCheck() {
+        return getInstance().options_.leak_check;
+    }
+
+    static void setLeakCheck(bool leak_check) {
+        getInstance().options_.leak_check = leak_check;
+    }
+
+    // record hardware performance counters for each test and benchmark (Linux only)
+    static bool getPerfCounters() {
+        return getInstance().options_.perf_counters;
+    }
+
+    static void setPerfCounters(bool perf_counters) {
+        getInstance().options_.perf_counters = perf_counters;
+    }
+
+    // bind the threads of a STRESS_TEST to one CPU each (Linux only)
+    static bool getStressPinThreads() {
+        return getInstance().options_.stress_pin_threads;
+    }
+
+    static void setStressPinThreads(bool pin) {
+        getInstance().options_.stress_pin_threads = pin;
+    }
+
+    // random cases tried per PROPERTY
+    static std::size_t getPropertyCases() {
+        return getInstance().options_.property_cases;
+    }
+
+    static void setPropertyCases(std::size_t cases) {
+        getInstance().options_.property_cases = cases;
+    }
+
+    // threads generating and checking the cases of a PROPERTY (0 = one per hardware thread)
+    static std::size_t getPropertyThreads() {
+        return getInstance().options_.property_threads;
+    }
+
+    static void setPropertyThreads(std::size_t threads) {
+        getInstance().options_.property_threads = threads;
+    }
+
+    // the event loop of CO_TEST runs on a clock which jumps to the next timer instead of sleeping
+    static bool getFakeClock() {
+        return getInstance().options_.fake_clock;
+    }
+
+    static void setFakeClock(bool fake) {
+        getInstance().options_.fake_clock = fake;
+    }
+
+    // failure messages recorded per test; further failures are only counted (0 = unlimited)
+    static std::size_t getMaxFailures() {
+        return getInstance().options_.max_failures;
+    }
+
+    static void setMaxFailures(std::size_t n) {
+        getInstance().options_.max_failures = n;
+    }
+
+    // file holding the timing samples of benchmarks and EXPECT_NOT_SLOWER_THAN_BASELINE blocks
+    static const std::string& getBaselinePath() {
+        return getInstance().options_.baseline_path;
+    }
+
+    static void setBaselinePath(const std::string& path) {
+        getInstance().options_.baseline_path = path;
+    }
+
+    // compare benchmarks against their baselines (EXPECT_NOT_SLOWER_THAN_BASELINE always is)
+    static bool getCompareBaselines() {
+        return getInstance().options_.compare_baselines;
+    }
+
+    static void setCompareBaselines(bool compare) {
+        getInstance().options_.compare_baselines = compare;
+    }
+
+    // record new baselines instead of comparing against the stored ones
+    static bool getUpdateBaselines() {
+        return getInstance().options_.update_baselines;
+    }
+
+    static void setUpdateBaselines(bool update) {
+        getInstance().options_.update_baselines = update;
+    }
+
+    // EXPECT_MATCHES_GOLDEN rewrites the golden files with the output instead of comparing
+    static bool getUpdateGoldens() {
+        return getInstance().options_.update_goldens;
+    }
+
+    static void setUpdateGoldens(bool update) {
+        getInstance().options_.update_goldens = update;
+    }
+
+    // slowdown a benchmark may show against its baseline, as a fraction (0.05 = 5%)
+    static double getBaselineTolerance() {
+        return getInstance().options_.baseline_tolerance;
+    }
+
+    static void setBaselineTolerance(double tolerance) {
+        getInstance().options_.baseline_tolerance = tolerance;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(TestState);
+
+    static TestCase*& threadTestCase() {
+        static thread_local TestCase* testcase = 0;
+        return testcase;
+    }
+
+    static Test*& threadTest() {
+        static thread_local Test* test = 0;
+        return test;
+    }
+
+    static Test*& adoptedTest() {
+        static thread_local Test* test = 0;
+        return test;
+    }
+
+    static const FailureContext*& failureContext() {
+        static thread_local const FailureContext* context = 0;
+        return context;
+    }
+
+    static FailureCapture*& failureCapture() {
+        static thread_local FailureCapture* capture = 0;
+        return capture;
+    }
+
+    // constant-initialized rather than members: the replaced operator new asks for the current test,
+    // possibly while the TestState instance itself is being constructed
+    static std::atomic<TestCase*>& lastTestCase() {
+        static std::atomic<TestCase*> testcase(0);
+        return testcase;
+    }
+
+    static std::atomic<Test*>& lastTest() {
+        static std::atomic<Test*> test(0);
+        return test;
+    }
+
+    Options options_;
+};
+
+struct Failure {
+    Failure(const std::string& file, int line, const std::string& expected, const std::string& actual)
+        : file(file), line(line), message(detail::makeMessage(expected, actual)), repeated(0) {}
+
+    Failure(const std::string& file, int line, const std::string& expression, bool expected)
+        : file(file), line(line), message(detail::makeMessage(expression, expected)), repeated(0) {}
+
+    Failure() : line(0), repeated(0) {}
+
+    static Failure fromMessage(const std::string& file, int line, const std::string& message) {
+        Failure f;
+        f.file = file;
+        f.line = line;
+        f.message = message;
+        return f;
+    }
+
+    // the message, and how often the same assertion failed again afterwards
+    std::string describe() const {
+        if (repeated == 0) return message;
+        return message + " (failed " + detail::toString(repeated) + " more times here)";
+    }
+
+    std::string file;
+    int line;
+    std::string message;
+    std::size_t repeated; // later failures at the same site which were only counted
+};
+
+// at most this many messages are recorded per assertion; later failures there are only counted
+const std::size_t FAILURE_MESSAGES_PER_SITE = 3;
+
+// failures aggregated per assertion site: a site keeps its first FAILURE_MESSAGES_PER_SITE messages
+// and counts the rest on the last of them. not synchronized.
+class FailureLog {
+public:
+    typedef std::vector<Failure> Failures;
+
+    FailureLog() : last_site_(0), dropped_(0) {}
+
+    // 'occurrences' failures happened at file:line. returns whether a message should be built and passed to add
+    // (which then stands for all of them); otherwise they are only counted
+    bool count(const char* file, int line, std::size_t max_failures, std::size_t occurrences = 1) {
+        Site& site = find(file, line);
+
+        if (site.recorded < FAILURE_MESSAGES_PER_SITE && (max_failures == 0 || failures_.size() < max_failures)) {
+            site.recorded++;
+            return true;
+        }
+        if (site.recorded == 0)
+            dropped_ += occurrences;
+        else if (site.last < failures_.size())
+            failures_[site.last].repeated += occurrences;
+        else
+            site.repeated += occurrences; // the message is still being built
+        return false;
+    }
+
+    void add(const Failure& failure) {
+        Site& site = find(failure.file.c_str(), failure.line);
+        site.last = failures_.size();
+        failures_.push_back(failure);
+        failures_.back().repeated += site.repeated;
+        site.repeated = 0;
+    }
+
+    const Failures& failures() const {
+        return failures_;
+    }
+
+    // failures at sites without a recorded message, beyond the max_failures passed to count
+    std::size_t dropped() const {
+        return dropped_;
+    }
+
+    void addDropped(std::size_t dropped) {
+        dropped_ += dropped;
+    }
+
+    // all failures counted, whether recorded or not
+    std::size_t total() const {
+        std::size_t n = dropped_;
+        for (Failures::const_iterator it = failures_.begin(), end = failures_.end(); it != end; ++it)
+            n += 1 + (*it).repeated;
+        return n;
+    }
+
+    void clear() {
+        failures_.clear();
+        sites_.clear();
+        last_site_ = 0;
+        dropped_ = 0;
+    }
+
+private:
+    struct Site {
+        Site(const char* file, int line) : file(file), line(line), recorded(0), last(static_cast<std::size_t>(-1)), repeated(0) {}
+
+        std::string file;
+        int line;
+        std::size_t recorded;
+        std::size_t last;     // index of its latest message in failures_
+        std::size_t repeated; // counted before that message was recorded
+    };
+
+    // consecutive failures mostly come from the same site
+    Site& find(const char* file, int line) {
+        if (last_site_ < sites_.size() && sites_[last_site_].line == line && sites_[last_site_].file == file)
+            return sites_[last_site_];
+
+        for (last_site_ = 0; last_site_ < sites_.size(); last_site_++)
+            if (sites_[last_site_].line == line && sites_[last_site_].file == file)
+                return sites_[last_site_];
+
+        sites_.push_back(Site(file, line));
+        return sites_.back();
+    }
+
+    Failures failures_;
+    std::vector<Site> sites_;
+    std::size_t last_site_;
+    std::size_t dropped_;
+};
+
+// failures of one thread spawned by a test body (see framework::threadFailures). owned by both the thread,
+// which keeps it cached, and the test until it merges it: a thread failing after that (a detached or pooled
+// one, or one which outlived the test it adopted) finds 'merged' set and takes a new buffer instead
+struct ThreadFailures {
+    ThreadFailures() : merged(false), ambiguous(false) {}
+
+    FailureLog log;
+    std::atomic<bool> merged;
+    bool ambiguous;   // bound to the most recently started test while others were running too
+    std::mutex mutex; // taken by the thread for each failure and by the merge, so only these two ever contend
+};
+
+// lock-free list of the ThreadFailures of a test, open only while the test runs: a buffer is refused otherwise
+// instead of being added where no merge would collect it. a copied test starts with a closed one
+struct ThreadFailuresList {
+    struct Node {
+        std::shared_ptr<ThreadFailures> failures;
+        Node* next;
+    };
+
+    // the head of a closed list
+    static Node* closed() {
+        static Node node;
+        return &node;
+    }
+
+    ThreadFailuresList() : head(closed()) {}
+    ThreadFailuresList(const ThreadFailuresList&) : head(closed()) {}
+    ThreadFailuresList& operator=(const ThreadFailuresList&) { return *this; }
+
+    std::atomic<Node*> head;
+};
+
+// receives the progress of a run. events are delivered one at a time, but in parallel runs
+// onTestStart/onFailure/onTestEnd arrive in completion order, possibly from worker threads.
+// onTestCaseEnd is always delivered in registration order.
+class EventListener {
+public:
+    virtual ~EventListener() {}
+
+    virtual void onRunStart(const Registry&) {}
+    virtual void onTestStart(const TestCase&, const Test&) {}
+    virtual void onFailure(const TestCase&, const Test&, const Failure&) {}
+    virtual void onTestEnd(const TestCase&, const Test&) {}
+    virtual void onTestCaseEnd(const TestCase&) {}
+    virtual void onRunEnd(const Registry&) {}
+};
+
+class EventListeners {
+public:
+    static EventListeners& getInstance() {
+        static EventListeners instance;
+        return instance;
+    }
+
+    ~EventListeners() {
+        for (std::size_t i = 0; i < listeners_.size(); i++)
+            delete listeners_[i];
+    }
+
+    // takes ownership. listeners should be appended before the run starts.
+    void append(EventListener* listener) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listeners_.push_back(listener);
+    }
+
+    // forgets the listeners without destroying them. used by forked workers: their results are
+    // replayed by the parent, and their copies of the reporters must not write (even at exit).
+    void abandon() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listeners_.clear();
+    }
+
+    void runStart(const Registry& r)                                  { dispatch(&EventListener::onRunStart, r); }
+    void testStart(const TestCase& c, const Test& t)                  { dispatch(&EventListener::onTestStart, c, t); }
+    void failure(const TestCase& c, const Test& t, const Failure& f)  { dispatch(&EventListener::onFailure, c, t, f); }
+    void testEnd(const TestCase& c, const Test& t)                    { dispatch(&EventListener::onTestEnd, c, t); }
+    void testCaseEnd(const TestCase& c)                               { dispatch(&EventListener::onTestCaseEnd, c); }
+    void runEnd(const Registry& r)                                    { dispatch(&EventListener::onRunEnd, r); }
+
+private:
+    EventListeners() {}
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(EventListeners);
+
+    template<typename Event, typename... Args>
+    void dispatch(Event event, const Args&... args) {
+        if (listeners_.empty()) return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < listeners_.size(); i++)
+            (listeners_[i]->*event)(args...);
+    }
+
+    std::vector<EventListener*> listeners_;
+    std::mutex mutex_;
+};
+
+// timings of a BENCHMARK, per iteration
+struct BenchmarkResult {
+    BenchmarkResult() : iterations(0), mean(0), median(0), stddev(0), min(0), cycles(0) {}
+
+    static BenchmarkResult fromSamples(std::size_t iterations, const std::vector<double>& samples, double cycles) {
+        BenchmarkResult r;
+        r.iterations = iterations;
+        r.samples = samples;
+        r.cycles = cycles;
+        if (samples.empty()) return r;
+
+        std::vector<double> sorted(samples);
+        std::sort(sorted.begin(), sorted.end());
+        const std::size_t n = sorted.size();
+
+        double sum = 0, sq = 0;
+        for (std::size_t i = 0; i < n; i++) sum += sorted[i];
+        r.mean = sum / n;
+        for (std::size_t i = 0; i < n; i++) sq += (sorted[i] - r.mean) * (sorted[i] - r.mean);
+
+        r.median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+        r.stddev = n > 1 ? std::sqrt(sq / (n - 1)) : 0;
+        r.min = sorted[0];
+        return r;
+    }
+
+    std::size_t iterations;      // per sample
+    std::vector<double> samples; // ns per iteration
+    double mean, median, stddev, min;
+    double cycles;               // mean time-stamp counter ticks per iteration (0 if unavailable)
+    detail::PerfCounts perf;     // per iteration, if TestState::getPerfCounters()
+};
+
+// what each thread of a STRESS_TEST got done
+struct StressResult {
+    struct Thread {
+        Thread() : iterations(0), ns(0), failures(0), cpu(-1) {}
+
+        uint64_t iterations;
+        double ns;
+        std::size_t failures;
+        int cpu; // pinned to, or -1
+    };
+
+    StressResult() : ns(0) {}
+
+    std::vector<Thread> threads;
+    double ns; // from the release of the threads until the last one finished
+};
+
+// heap usage of a test, gathered when PICOTEST_TRACK_ALLOCATIONS is defined
+struct AllocationStats {
+    AllocationStats() : count(0), bytes(0), peak_bytes(0), live_count(0), live_bytes(0) {}
+
+    uint64_t count;      // allocations made while the test ran
+    uint64_t bytes;
+    uint64_t peak_bytes; // highest live_bytes
+    uint64_t live_count; // allocations not freed yet; leaks, once the test has returned
+    uint64_t live_bytes;
+};
+
+// updated from any thread the test allocates on. each allocation remembers its counters
+// and they are never destroyed, so memory freed at exit does not touch a destroyed Test.
+class AllocationCounters {
+public:
+    AllocationCounters() : active_(false), count_(0), bytes_(0), peak_bytes_(0), live_count_(0), live_bytes_(0) {}
+
+    // from a pool which stays reachable until exit, so leak checkers do not report it
+    static AllocationCounters* create() {
+        static std::mutex mutex;
+        static std::deque<AllocationCounters>* pool = new std::deque<AllocationCounters>;
+        std::lock_guard<std::mutex> lock(mutex);
+        pool->emplace_back();
+        return &pool->back();
+    }
+
+    void start() {
+        count_ = bytes_ = peak_bytes_ = live_count_ = live_bytes_ = 0;
+        active_ = true;
+    }
+
+    void stop() {
+        active_ = false;
+    }
+
+    // false if the test is not running, in which case the allocation is not charged to it
+    bool allocated(std::size_t size) {
+        if (!active_.load(std::memory_order_relaxed)) return false;
+
+        count_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(size, std::memory_order_relaxed);
+        live_count_.fetch_add(1, std::memory_order_relaxed);
+        const uint64_t live = live_bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+        uint64_t peak = peak_bytes_.load(std::memory_order_relaxed);
+        while (live > peak && !peak_bytes_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+        return true;
+    }
+
+    void freed(std::size_t size) {
+        live_count_.fetch_sub(1, std::memory_order_relaxed);
+        live_bytes_.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    AllocationStats stats() const {
+        AllocationStats s;
+        s.count = count_;
+        s.bytes = bytes_;
+        s.peak_bytes = peak_bytes_;
+        s.live_count = live_count_;
+        s.live_bytes = live_bytes_;
+        return s;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(AllocationCounters);
+
+    std::atomic<bool> active_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> peak_bytes_;
+    std::atomic<uint64_t> live_count_;
+    std::atomic<uint64_t> live_bytes_;
+};
+
+/***** watchdog *****/
+
+// fails a test which is still running after its timeout. a hung thread cannot be stopped,
+// so its backtrace is printed and the run is aborted with a summary of how far it got
+// (see expire). worker processes leave this to their parent, which kills only the worker.
+class Watchdog {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static Watchdog& getInstance() {
+        detail::AllocationTrackingPause pause;
+        static Watchdog* instance = new Watchdog; // never destroyed: its thread still waits at exit
+        return *instance;
+    }
+
+    // watches the calling thread while it runs a test
+    class Guard {
+    public:
+        Guard(Test* test, double timeout_ms) : id_(timeout_ms > 0 ? Watchdog::getInstance().watch(test, timeout_ms) : 0) {}
+
+        ~Guard() {
+            if (id_) Watchdog::getInstance().unwatch(id_);
+        }
+
+    private:
+        PICOTEST_DISALLOW_COPY_AND_ASSIGN(Guard);
+
+        uint64_t id_;
+    };
+
+    // disabled in worker processes; does not lock, since a fork may have happened with the lock held
+    void setEnabled(bool enabled) {
+        enabled_ = enabled;
+    }
+
+    // progress of the current run, kept in counters which expire can read without locking
+    static void runStarted(std::size_t tests) {
+        totalTests() = tests;
+        finishedTests() = 0;
+        failedTests() = 0;
+    }
+
+    static void testFinished(bool failed) {
+        finishedTests()++;
+        if (failed) failedTests()++;
+    }
+
+private:
+    struct Entry {
+        uint64_t id;
+        Clock::time_point deadline;
+        char message[256]; // formatted by watch, as expire must not allocate
+#ifdef PICOTEST_POSIX
+        pthread_t thread;
+#endif
+    };
+
+    Watchdog() : enabled_(true), started_(false), next_id_(1) {}
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(Watchdog);
+
+    uint64_t watch(Test* test, double timeout_ms);
+
+    void unwatch(uint64_t id) {
+        detail::AllocationTrackingPause pause;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < entries_.size(); i++) {
+            if (entries_[i].id != id) continue;
+            entries_.erase(entries_.begin() + i);
+            return;
+        }
+    }
+
+    void run() {
+        detail::threadAllocations().paused++; // never charged to a test
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        for (;;) {
+            if (entries_.empty()) {
+                changed_.wait(lock);
+                continue;
+            }
+
+            std::size_t first = 0;
+            for (std::size_t i = 1; i < entries_.size(); i++)
+                if (entries_[i].deadline < entries_[first].deadline) first = i;
+
+            if (Clock::now() < entries_[first].deadline) {
+                changed_.wait_until(lock, entries_[first].deadline);
+                continue;
+            }
+
+            const Entry expired = entries_[first];
+            lock.unlock();
+            expire(expired); // does not return
+        }
+    }
+
+    void expire(const Entry& entry);
+
+    // straight to the file: the hung thread may hold the lock of a stdio stream
+    static void writeRaw(int fd, const char* data, std::size_t size) {
+#ifdef PICOTEST_POSIX
+        detail::writeAll(fd, data, size);
+#elif defined PICOTEST_WINDOWS
+        DWORD written;
+        ::WriteFile(::GetStdHandle(fd == 1 ? STD_OUTPUT_HANDLE : STD_ERROR_HANDLE), data, static_cast<DWORD>(size), &written, 0);
+#else
+        fwrite(data, 1, size, fd == 1 ? stdout : stderr);
+#endif
+    }
+
+    // constant-initialized, like TestState::lastTest
+    static std::atomic<std::size_t>& totalTests() {
+        static std::atomic<std::size_t> n(0);
+        return n;
+    }
+
+    static std::atomic<std::size_t>& finishedTests() {
+        static std::atomic<std::size_t> n(0);
+        return n;
+    }
+
+    static std::atomic<std::size_t>& failedTests() {
+        static std::atomic<std::size_t> n(0);
+        return n;
+    }
+
+    std::atomic<bool> enabled_;
+    bool started_;
+    uint64_t next_id_;
+    std::vector<Entry> entries_; // running tests with a timeout
+    std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+// the instances [begin, end) of a TEST_P pattern under one INSTANTIATE_TEST_CASE_P, which a Test stands for
+struct ParamRange {
+    const ParamInstantiationInfo* instantiation; // 0 if the test is not parameterized
+    const ParamTestInfo* test;
+    std::size_t begin;
+    std::size_t end;
+};
+
+class Test {
+public:
+    typedef FailureLog::Failures Failures;
+    typedef void (*TestFunc)(void);
+
+    Test (const std::string& name, TestFunc f, unsigned flags = 0)
+        : executed_(false), enabled_(true), flags_(flags), wall_ns_(0), cpu_ns_(0), testcase_(0), allocations_(0),
+          execution_(0), timeout_ms_(0), runs_(0), failed_runs_(0), first_failed_run_(0), params_(), name_(name), f_(f) {}
+
+    void execute() {
+        // created before the test becomes visible to other threads through TestState
+        if (detail::allocationTrackingEnabled() && !allocations_) allocations_ = AllocationCounters::create();
+        thread_failures_.head.store(0, std::memory_order_relaxed); // opened before the test becomes visible
+        TestState::setCurrentTest(this);
+        execution_++;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const double cpu_start = detail::threadCpuTimeNs();
+        detail::ThreadAllocations& thread = detail::threadAllocations();
+        const int paused = thread.paused;
+        thread.paused = 0; // the body is charged even when it runs on a (paused) worker thread
+        if (allocations_) allocations_->start();
+        const bool perf = TestState::getPerfCounters();
+        const detail::PerfCounts perf_start = perf ? detail::PerfCounterGroup::forThisThread().read() : detail::PerfCounts();
+        TestState::runningTests()++;
+        {
+            Watchdog::Guard watchdog(this, timeoutMs());
+            f_();
+        }
+        TestState::runningTests()--;
+        if (perf) perf_ = detail::PerfCounterGroup::forThisThread().read().since(perf_start);
+        if (allocations_) allocations_->stop();
+        thread.paused = paused;
+        cpu_ns_ = detail::threadCpuTimeNs() - cpu_start;
+        wall_ns_ = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        finishExecution();
+    }
+
+    // a CO_TEST interleaved with others only hands its body to the event loop here; the loop calls
+    // finishCoroutine once the body has completed (see Registry::runCoroutines)
+    void startCoroutine() {
+        if (detail::allocationTrackingEnabled() && !allocations_) allocations_ = AllocationCounters::create();
+        thread_failures_.head.store(0, std::memory_order_relaxed);
+        TestState::setCurrentTest(this);
+        execution_++;
+
+        start_ = std::chrono::steady_clock::now();
+        if (allocations_) allocations_->start();
+        TestState::runningTests()++;
+        f_();
+    }
+
+    // the wall-clock time runs from start to completion; the CPU time is that of the body's own slices of the loop
+    void finishCoroutine(double cpu_ns) {
+        TestState::runningTests()--;
+        if (allocations_) allocations_->stop();
+        cpu_ns_ = cpu_ns;
+        wall_ns_ = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count();
+        finishExecution();
+    }
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    // the testcase this test was added to
+    TestCase* testCase() const {
+        return testcase_;
+    }
+
+    void setTestCase(TestCase* testcase) {
+        testcase_ = testcase;
+    }
+
+    // a test which is not selected to run (e.g. belongs to another shard) never fails
+    bool success() const {
+        return !enabled_ || (executed_ && log_.failures().empty());
+    }
+
+    bool enabled() const {
+        return enabled_;
+    }
+
+    void setEnabled(bool enabled) {
+        enabled_ = enabled;
+    }
+
+    bool executed() const {
+        return executed_;
+    }
+
+    // used when the test body ran somewhere else (i.e. in a worker process)
+    void setExecuted() {
+        executed_ = true;
+    }
+
+    // forgets the results of the last execution, before the next --repeat iteration
+    void reset() {
+        executed_ = false;
+        wall_ns_ = cpu_ns_ = 0;
+        perf_ = detail::PerfCounts();
+        log_.clear();
+        benchmark_ = BenchmarkResult();
+        stress_ = StressResult();
+    }
+
+    // adds the last execution to the outcome over all iterations
+    void recordRun(std::size_t iteration) {
+        if (!enabled_ || !executed_) return;
+
+        runs_++;
+        if (success()) return;
+        if (failed_runs_++ == 0) {
+            first_failed_run_ = iteration;
+            first_failures_ = log_.failures();
+        }
+    }
+
+    std::size_t runs() const {
+        return runs_;
+    }
+
+    std::size_t failedRuns() const {
+        return failed_runs_;
+    }
+
+    // how often the test failed over the iterations, with the failures of the first failed one
+    template<typename Char, typename CharTraits>
+    void reportRuns(std::basic_ostream<Char, CharTraits>& os, uint32_t first_seed) const {
+        os << name_ << " : failed " << failed_runs_ << " of " << runs_ << " runs ("
+           << std::fixed << std::setprecision(1) << 100.0 * failed_runs_ / (runs_ ? runs_ : 1) << "%)"
+           << std::resetiosflags(std::ios::floatfield) << ", first in run " << first_failed_run_ + 1;
+        if (TestState::getShuffle()) os << " (seed " << first_seed + first_failed_run_ << ")";
+        os << "\n";
+        for (Failures::const_iterator it = first_failures_.begin(), end = first_failures_.end(); it != end; ++it) {
+            os << "  ";
+            report(os, *it);
+        }
+    }
+
+    // effective timeout of the test: its own (TEST_TIMEOUT) or TestState::getTimeoutMs()
+    double timeoutMs() const {
+        return timeout_ms_ > 0 ? timeout_ms_ : TestState::getTimeoutMs();
+    }
+
+    void setTimeoutMs(double ms) {
+        timeout_ms_ = ms;
+    }
+
+    const Failures& failures() const {
+        return log_.failures();
+    }
+
+    bool serial() const {
+        return (flags_ & TestFlagSerial) != 0;
+    }
+
+    bool coroutine() const {
+        return (flags_ & TestFlagCoroutine) != 0;
+    }
+
+    // wall-clock and thread CPU time of the last execution, in nanoseconds
+    double wallTime() const {
+        return wall_ns_;
+    }
+
+    double cpuTime() const {
+        return cpu_ns_;
+    }
+
+    void setTime(double wall_ns, double cpu_ns) {
+        wall_ns_ = wall_ns;
+        cpu_ns_ = cpu_ns;
+    }
+
+    bool hasBenchmark() const {
+        return benchmark_.iterations > 0;
+    }
+
+    bool hasStress() const {
+        return !stress_.threads.empty();
+    }
+
+    const ParamRange& params() const {
+        return params_;
+    }
+
+    void setParams(const ParamRange& params) {
+        params_ = params;
+    }
+
+    const StressResult& stress() const {
+        return stress_;
+    }
+
+    void setStress(const StressResult& result) {
+        detail::AllocationTrackingPause pause;
+        stress_ = result;
+    }
+
+    const BenchmarkResult& benchmark() const {
+        return benchmark_;
+    }
+
+    void setBenchmark(const BenchmarkResult& result) {
+        detail::AllocationTrackingPause pause;
+        benchmark_ = result;
+    }
+
+    // counters of the test while it is running; 0 unless allocation tracking is enabled
+    AllocationCounters* allocationCounters() const {
+        return allocations_;
+    }
+
+    AllocationStats allocations() const {
+        return allocations_ ? allocations_->stats() : AllocationStats();
+    }
+
+    // performance counters over the last execution, if TestState::getPerfCounters()
+    const detail::PerfCounts& perfCounts() const {
+        return perf_;
+    }
+
+    void setPerfCounts(const detail::PerfCounts& counts) {
+        perf_ = counts;
+    }
+
+    template<typename Char, typename CharTraits>
+    void reportPerfCounts(std::basic_ostream<Char, CharTraits>& os) const {
+        os << name_ << " : " << detail::formatPerfCounts(perf_) << "\n";
+    }
+
+    template<typename Char, typename CharTraits>
+    void reportBenchmark(std::basic_ostream<Char, CharTraits>& os) const {
+        os << name_ << " : mean " << detail::formatDuration(benchmark_.mean)
+           << ", median " << detail::formatDuration(benchmark_.median)
+           << ", stddev " << detail::formatDuration(benchmark_.stddev)
+           << ", min " << detail::formatDuration(benchmark_.min)
+           << " (" << benchmark_.samples.size() << " x " << benchmark_.iterations << " iterations";
+        if (benchmark_.cycles > 0)
+            os << ", " << static_cast<uint64_t>(benchmark_.cycles + 0.5) << " cycles";
+        if (benchmark_.perf.available) {
+            detail::PerfCounts perf = benchmark_.perf;
+            if (benchmark_.cycles > 0) perf.available &= ~(1u << detail::PerfCycles); // already shown
+            os << ", " << detail::formatPerfCounts(perf);
+        }
+        os << ")\n";
+    }
+
+    template<typename Char, typename CharTraits>
+    void reportStress(std::basic_ostream<Char, CharTraits>& os) const {
+        uint64_t iterations = 0;
+        for (std::size_t i = 0; i < stress_.threads.size(); i++)
+            iterations += stress_.threads[i].iterations;
+
+        os << name_ << " : " << stress_.threads.size() << " threads, " << iterations << " iterations in "
+           << detail::formatDuration(stress_.ns);
+        if (stress_.ns > 0) os << ", " << detail::formatRate(iterations * 1e9 / stress_.ns);
+        os << "\n";
+
+        for (std::size_t i = 0; i < stress_.threads.size(); i++) {
+            const StressResult::Thread& t = stress_.threads[i];
+            os << "  thread " << i;
+            if (t.cpu >= 0) os << " (cpu " << t.cpu << ")";
+            os << " : " << t.iterations << " iterations";
+            if (t.ns > 0) os << ", " << detail::formatRate(t.iterations * 1e9 / t.ns);
+            if (t.failures) os << ", " << t.failures << " failure(s)";
+            os << "\n";
+        }
+    }
+
+    void setFailure(const Failure& failure) {
+        if (countFailure(failure.file.c_str(), failure.line)) addFailure(failure);
+    }
+
+    // an assertion failed at file:line. returns whether its message should be built and passed to addFailure;
+    // otherwise the failure is only counted, so that an assertion failing in a tight loop stays cheap.
+    // only the thread running the test calls it; spawned threads count into their own buffers, folded
+    // into this log once when the test ends (see mergeThreadFailures), so asserting threads never contend with each other
+    bool countFailure(const char* file, int line) {
+        detail::AllocationTrackingPause pause;
+        return log_.count(file, line, TestState::getMaxFailures());
+    }
+
+    // records a failure without counting it against the limits (see countFailure)
+    void addFailure(const Failure& failure) {
+        detail::AllocationTrackingPause pause;
+        log_.add(failure);
+        if (testcase_) EventListeners::getInstance().failure(*testcase_, *this, failure);
+    }
+
+    // counts the executions, so that a spawned thread notices when its buffer belongs to an earlier one
+    uint64_t execution() const {
+        return execution_;
+    }
+
+    // a failure buffer for a thread spawned by the test body, or null if the body has returned since (its
+    // failures would never be merged). lock-free, as there may be many such threads
+    std::shared_ptr<ThreadFailures> addThreadFailures() {
+        detail::AllocationTrackingPause pause;
+        const std::shared_ptr<ThreadFailures> failures = std::make_shared<ThreadFailures>();
+        ThreadFailuresList::Node* node = new ThreadFailuresList::Node;
+        node->failures = failures; // the node is the merge's once it is in the list
+        node->next = thread_failures_.head.load(std::memory_order_relaxed);
+        do {
+            if (node->next == ThreadFailuresList::closed()) {
+                delete node;
+                return std::shared_ptr<ThreadFailures>();
+            }
+        } while (!thread_failures_.head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+        return failures;
+    }
+
+    template<typename Char, typename CharTraits>
+    void reportFailure(std::basic_ostream<Char, CharTraits>& os) const {
+        for (Failures::const_iterator it = log_.failures().begin(), end = log_.failures().end(); it != end; ++it) 
+            report(os, (*it));
+    }
+
+private:
+    void finishExecution() {
+        executed_ = true;
+        mergeThreadFailures();
+        checkTimeBudget();
+        checkLeaks();
+        reportDropped();
+        Watchdog::testFinished(!success());
+    }
+
+    void checkTimeBudget() {
+        const double budget_ns = TestState::getTimeBudgetMs() * 1e6;
+        if (budget_ns <= 0 || hasBenchmark() || wall_ns_ <= budget_ns) return;
+
+        setFailure(Failure::fromMessage("", 0, "took " + detail::formatDuration(wall_ns_) +
+            ", exceeding the time budget of " + detail::formatDuration(budget_ns)));
+    }
+
+    void checkLeaks() {
+        if (!allocations_ || !TestState::getLeakCheck()) return;
+
+        const AllocationStats stats = allocations_->stats();
+        if (stats.live_count == 0) return;
+
+        std::ostringstream os;
+        os << "leaked " << stats.live_count << " allocation(s), " << stats.live_bytes << " bytes";
+        setFailure(Failure::fromMessage("", 0, os.str()));
+    }
+
+    // spawned threads have been joined by the time the body returns; their failures count
+    // against the limits of the test as if they had been recorded directly
+    void mergeThreadFailures() {
+        ThreadFailuresList::Node* node = thread_failures_.head.exchange(ThreadFailuresList::closed(), std::memory_order_acquire);
+
+        while (node) {
+            ThreadFailures* buffer = node->failures.get();
+            buffer->merged.store(true, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                const Failures& failures = buffer->log.failures();
+                for (Failures::const_iterator it = failures.begin(), end = failures.end(); it != end; ++it) {
+                    if (log_.count((*it).file.c_str(), (*it).line, TestState::getMaxFailures(), 1 + (*it).repeated))
+                        addFailure(*it);
+                }
+                log_.addDropped(buffer->log.dropped());
+            }
+
+            ThreadFailuresList::Node* next = node->next;
+            detail::AllocationTrackingPause pause;
+            delete node; // the thread may still hold the buffer
+            node = next;
+        }
+    }
+
+    void reportDropped() {
+        const std::size_t dropped = log_.dropped();
+        if (dropped == 0) return;
+
+        std::ostringstream os;
+        os << dropped << " more failure(s) were not recorded (raise --picotest_max_failures to see them)";
+        addFailure(Failure::fromMessage("", 0, os.str()));
+    }
+
+    template<typename Char, typename CharTraits>
+    void report(std::basic_ostream<Char, CharTraits>& os, const Failure& f) const {
+        os << name_ << " : ";
+        if (!f.file.empty()) os << f.file << "(" << f.line << "): ";
+        os << f.describe() << "\n";
+    }
+
+    bool executed_;
+    bool enabled_;
+    unsigned flags_;
+    double wall_ns_;
+    double cpu_ns_;
+    TestCase* testcase_;
+    AllocationCounters* allocations_; // shared by copies, never freed (see AllocationCounters)
+    detail::PerfCounts perf_;
+    FailureLog log_;                      // written by the thread running the test only
+    ThreadFailuresList thread_failures_; // of spawned threads, merged when the body returns
+    uint64_t execution_;
+    double timeout_ms_;
+    std::size_t runs_;        // over all --repeat iterations
+    std::size_t failed_runs_;
+    std::size_t first_failed_run_;
+    Failures first_failures_;
+    BenchmarkResult benchmark_;
+    StressResult stress_;
+    ParamRange params_;
+    std::chrono::steady_clock::time_point start_; // of a CO_TEST in progress
+    std::string name_;
+    TestFunc f_;
+};
+
+/***** assertions from any thread *****/
+
+// failures of spawned threads which no running test could take, reported with the run (see Registry::runOnce)
+inline ThreadFailures& strayThreadFailures() {
+    static ThreadFailures failures;
+    return failures;
+}
+
+// failures of the calling thread go to its current test: directly on the thread running the test,
+// into a buffer of the thread otherwise (one spawned by the test body), merged when the body returns.
+// a thread which adopted a test (see AdoptTest) writes to that one's buffer. any other thread is bound to the
+// test running when it first fails and stays with it until that test has merged its buffer, even if more tests
+// start meanwhile; where several tests ran at that moment, its failures say that they may belong to another.
+// a thread whose test has already returned, or which fails before any test started, has no test to go to: its
+// failures fail the run instead (see strayThreadFailures).
+inline ThreadFailures& threadFailures() {
+    static thread_local Test* owner = 0;
+    static thread_local uint64_t execution = 0;
+    static thread_local std::shared_ptr<ThreadFailures> buffer;
+
+    Test* test = TestState::getAdoptedTest();
+    if (test ? owner != test || execution != test->execution() || buffer->merged.load(std::memory_order_relaxed)
+             : !buffer || buffer->merged.load(std::memory_order_relaxed)) {
+        if (!test) test = TestState::getCurrentTest();
+        std::shared_ptr<ThreadFailures> added = test ? test->addThreadFailures() : std::shared_ptr<ThreadFailures>();
+        if (!added) return strayThreadFailures();
+        buffer = added;
+        buffer->ambiguous = !TestState::getAdoptedTest() && TestState::runningTests() > 1;
+        owner = test;
+        execution = test->execution();
+    }
+    return *buffer;
+}
+
+inline void recordFailure(const Failure& failure) {
+    if (TestState::onTestThread()) {
+        TestState::getCurrentTest()->addFailure(failure);
+        return;
+    }
+
+    detail::AllocationTrackingPause pause;
+    for (;;) {
+        // the test need not have joined the thread, so the buffer may be merged at any time
+        ThreadFailures& buffer = threadFailures();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.merged.load(std::memory_order_relaxed)) continue;
+
+        if (!buffer.ambiguous) {
+            buffer.log.add(failure);
+            return;
+        }
+        Failure noted(failure);
+        noted.message += " (on a thread which did not adopt a test while several were running: it may belong to"
+                         " another one, see AdoptTest)";
+        buffer.log.add(noted);
+        return;
+    }
+}
+
+inline void addFailure(const Failure& failure) {
+    const FailureContext* context = TestState::getFailureContext();
+    if (!context) {
+        recordFailure(failure);
+        return;
+    }
+
+    detail::AllocationTrackingPause pause;
+    Failure described(failure);
+    described.message = context->describe() + ": " + failure.message;
+    recordFailure(described);
+}
+
+inline void setFailure(const Failure& failure) {
+    if (countFailure(failure.file.c_str(), failure.line)) addFailure(failure);
+}
+
+// makes a thread spawned by a test body report its failures (and allocations) to that test. needed
+// only when tests run in parallel; otherwise a spawned thread reports to the test running when it first fails.
+//   auto test = TestState::getCurrentTest();
+//   std::thread worker([test] { AdoptTest adopt(test); EXPECT_TRUE(...); });
+class AdoptTest {
+public:
+    explicit AdoptTest(Test* test) {
+        TestState::setAdoptedTest(test);
+    }
+
+    ~AdoptTest() {
+        TestState::setAdoptedTest(0);
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(AdoptTest);
+};
+
+/***** allocation tracking *****/
+
+// placed in front of every block handed out by the replaced operator new
+struct AllocationHeader {
+    AllocationCounters* owner; // 0 if the allocation was not charged to a test
+    std::size_t size;
+};
+
+inline std::size_t allocationPadding(std::size_t align) {
+    return align > 16 ? align : 16;
+}
+
+// align is 0 for the ordinary operator new; returns 0 when out of memory
+inline void* allocateTracked(std::size_t size, std::size_t align) {
+    const std::size_t padding = allocationPadding(align);
+    void* raw;
+    if (align <= 16)
+        raw = malloc(padding + size);
+#if defined PICOTEST_WINDOWS
+    else
+        raw = _aligned_malloc(padding + size, padding);
+#elif defined PICOTEST_POSIX
+    else if (posix_memalign(&raw, padding, padding + size) != 0)
+        raw = 0;
+#else
+    else
+        raw = aligned_alloc(padding, (padding + size + padding - 1) / padding * padding);
+#endif
+    if (!raw) return 0;
+
+    void* p = static_cast<char*>(raw) + padding;
+    AllocationHeader* header = static_cast<AllocationHeader*>(p) - 1;
+    header->owner = 0;
+    header->size = size;
+
+    detail::ThreadAllocations& thread = detail::threadAllocations();
+    if (thread.paused == 0) {
+        thread.count++;
+        thread.bytes += size;
+        Test* test = TestState::getCurrentTest();
+        AllocationCounters* counters = test ? test->allocationCounters() : 0;
+        if (counters && counters->allocated(size)) header->owner = counters;
+    }
+    return p;
+}
+
+inline void freeTracked(void* p, std::size_t align) {
+    if (!p) return;
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(p) - 1;
+    if (header->owner) header->owner->freed(header->size);
+
+    void* raw = static_cast<char*>(p) - allocationPadding(align);
+#ifdef PICOTEST_WINDOWS
+    if (align > 16) {
+        _aligned_free(raw);
+        return;
+    }
+#endif
+    free(raw);
+}
+
+inline void* allocateTrackedOrThrow(std::size_t size, std::size_t align) {
+    for (;;) {
+        if (void* p = allocateTracked(size, align)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+// the body of EXPECT_NO_ALLOC/EXPECT_MAX_ALLOCS, which runs exactly once while this is alive.
+// counts the allocations of the calling thread only, so parallel tests do not interfere.
+class AllocationScope {
+public:
+    AllocationScope(uint64_t max_allocs, const char* file, int line)
+        : max_allocs_(max_allocs), count_(detail::threadAllocations().count), bytes_(detail::threadAllocations().bytes),
+          file_(file), line_(line), done_(false) {}
+
+    ~AllocationScope() {
+        if (!detail::allocationTrackingEnabled()) {
+            setFailure(Failure::fromMessage(file_, line_,
+                "allocation tracking is disabled; define PICOTEST_TRACK_ALLOCATIONS in one translation unit"));
+            return;
+        }
+
+        const uint64_t count = detail::threadAllocations().count - count_;
+        const uint64_t bytes = detail::threadAllocations().bytes - bytes_;
+        if (count <= max_allocs_) return;
+
+        std::ostringstream expected, actual;
+        expected << "allocations <= " << max_allocs_;
+        actual << count << " <= " << max_allocs_ << " (" << bytes << " bytes)";
+        setFailure(Failure(file_, line_, expected.str(), actual.str()));
+    }
+
+    bool once() {
+        if (done_) return false;
+        done_ = true;
+        return true;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(AllocationScope);
+
+    uint64_t max_allocs_;
+    uint64_t count_;
+    uint64_t bytes_;
+    const char* file_;
+    int line_;
+    bool done_;
+};
+
+// the body of EXPECT_PERF_COUNTER_LT/EXPECT_CACHE_MISSES_LT, which runs exactly once while this is alive.
+// where the counter is not available (no PMU access, not Linux) nothing is checked and a note is printed once.
+class PerfCounterScope {
+public:
+    PerfCounterScope(detail::PerfCounter counter, double limit, const char* file, int line)
+        : counter_(counter), limit_(limit), file_(file), line_(line), done_(false),
+          start_(detail::PerfCounterGroup::forThisThread().read()) {}
+
+    ~PerfCounterScope() {
+        const detail::PerfCounts counts = detail::PerfCounterGroup::forThisThread().read().since(start_);
+
+        if (!counts.has(counter_)) {
+            static std::atomic<bool> noted(false);
+            if (!noted.exchange(true))
+                fprintf(stderr, "picotest: %s(%d): %s counter is not available (check /proc/sys/kernel/perf_event_paranoid); "
+                    "performance counter assertions are skipped\n", file_, line_, detail::perfCounterName(counter_));
+            return;
+        }
+        if (counts.values[counter_] < limit_) return;
+
+        std::ostringstream expected, actual;
+        expected << detail::perfCounterName(counter_) << " < " << limit_;
+        actual << static_cast<uint64_t>(counts.values[counter_]) << " < " << limit_;
+        setFailure(Failure(file_, line_, expected.str(), actual.str()));
+    }
+
+    bool once() {
+        if (done_) return false;
+        done_ = true;
+        return true;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(PerfCounterScope);
+
+    detail::PerfCounter counter_;
+    double limit_;
+    const char* file_;
+    int line_;
+    bool done_;
+    detail::PerfCounts start_;
+};
+
+/***** performance baselines *****/
+
+// timing samples from earlier runs, one "key<TAB>ns ns ns..." line per key.
+// updates are appended as they happen (forked workers included) and compact(), called by the parent process
+// once the run is over, keeps the last line per key.
+class Baselines {
+public:
+    static Baselines& getInstance() {
+        static Baselines instance;
+        return instance;
+    }
+
+    bool find(const std::string& key, std::vector<double>& samples) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!loaded_) {
+            load(samples_);
+            loaded_ = true;
+        }
+        Samples::const_iterator it = samples_.find(key);
+        if (it == samples_.end()) return false;
+        samples = it->second;
+        return true;
+    }
+
+    void update(const std::string& key, const std::vector<double>& samples) {
+        std::ostringstream os;
+        os << std::setprecision(9) << sanitize(key) << "\t";
+        for (std::size_t i = 0; i < samples.size(); i++)
+            os << (i ? " " : "") << samples[i];
+        os << "\n";
+
+        const std::string line = os.str();
+        const std::string& path = TestState::getBaselinePath();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+#ifdef PICOTEST_POSIX
+        // one write(2) to a file opened with O_APPEND, however long the line: lines of concurrent workers
+        // never interleave (stdio would split a line longer than its buffer into several writes)
+        const int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        const bool written = fd >= 0 && ::write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size());
+        if (fd >= 0) ::close(fd);
+#else
+        // no worker processes here, and the threads of this one hold mutex_
+        FILE* file = fopen(path.c_str(), "a");
+        bool written = file && fputs(line.c_str(), file) >= 0;
+        if (file && fclose(file) != 0) written = false;
+#endif
+        if (!written)
+            fprintf(stderr, "picotest: cannot write baseline file '%s'\n", path.c_str());
+    }
+
+    // after a run with --update_baselines, rewrites the file atomically with the latest samples of each key if
+    // some key has several lines. the file decides, not this process: with --picotest_fork the workers append.
+    void compact() {
+        if (!TestState::getUpdateBaselines()) return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Samples latest;
+        if (load(latest) == latest.size()) return;
+
+        std::ostringstream os;
+        os << std::setprecision(9);
+        for (Samples::const_iterator it = latest.begin(); it != latest.end(); ++it) {
+            os << it->first << "\t";
+            for (std::size_t i = 0; i < it->second.size(); i++)
+                os << (i ? " " : "") << it->second[i];
+            os << "\n";
+        }
+        const std::string content = os.str();
+        if (!detail::writeFileAtomically(TestState::getBaselinePath(), content.data(), content.size()))
+            fprintf(stderr, "picotest: cannot write baseline file '%s'\n", TestState::getBaselinePath().c_str());
+    }
+
+private:
+    typedef std::map<std::string, std::vector<double> > Samples;
+
+    Baselines() : loaded_(false) {}
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(Baselines);
+
+    static std::string sanitize(std::string key) {
+        std::replace(key.begin(), key.end(), '\t', ' ');
+        std::replace(key.begin(), key.end(), '\n', ' ');
+        return key;
+    }
+
+    // returns the number of lines read; a later line of the same key replaces an earlier one
+    static std::size_t load(Samples& samples) {
+        std::ifstream in(TestState::getBaselinePath().c_str());
+        std::string line;
+        std::size_t lines = 0;
+        while (std::getline(in, line)) {
+            const std::string::size_type tab = line.find('\t');
+            if (tab == std::string::npos) continue;
+
+            std::istringstream values(line.substr(tab + 1));
+            std::vector<double> v;
+            double x;
+            while (values >> x) v.push_back(x);
+            samples[line.substr(0, tab)] = v;
+            lines++;
+        }
+        return lines;
+    }
+
+    std::mutex mutex_;
+    bool loaded_;
+    Samples samples_;
+};
+
+// a regression is reported when the samples are slower than the baseline scaled by (1 + tolerance)
+// with this significance
+const double BASELINE_SIGNIFICANCE = 0.01;
+
+// compares timing samples (ns) with the baseline stored under 'key', or records them with --update_baselines.
+// nothing is checked if there is no baseline yet; returns false if that is the case.
+inline bool checkBaseline(const std::string& key, const std::vector<double>& samples, double tolerance,
+                          const char* file, int line) {
+    if (TestState::getUpdateBaselines()) {
+        Baselines::getInstance().update(key, samples);
+        return true;
+    }
+
+    std::vector<double> baseline;
+    if (!Baselines::getInstance().find(key, baseline)) return false;
+
+    std::vector<double> allowed(baseline);
+    for (std::size_t i = 0; i < allowed.size(); i++) allowed[i] *= 1 + tolerance;
+
+    const double p = detail::mannWhitneyGreater(allowed, samples);
+    if (p >= BASELINE_SIGNIFICANCE) return true;
+
+    const double now = detail::median(samples), then = detail::median(baseline);
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1) << "'" << key << "' is slower than its baseline: median "
+       << detail::formatDuration(now) << " vs " << detail::formatDuration(then)
+       << " (" << std::showpos << (then > 0 ? (now / then - 1) * 100 : 0) << std::noshowpos << "%, tolerance "
+       << tolerance * 100 << "%, Mann-Whitney p = " << std::setprecision(4) << std::defaultfloat << p << ")";
+    setFailure(Failure::fromMessage(file, line, os.str()));
+    return true;
+}
+
+// runs the body of EXPECT_NOT_SLOWER_THAN_BASELINE once to warm up, then once per benchmark sample,
+// timing each run
+class BaselineScope {
+public:
+    BaselineScope(const std::string& key, double tolerance, const char* file, int line)
+        : key_(key), tolerance_(tolerance), file_(file), line_(line), runs_(0) {}
+
+    bool next() {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (runs_ > 1) samples_.push_back(std::chrono::duration<double, std::nano>(now - start_).count());
+
+        if (runs_++ <= TestState::getBenchmarkSamples()) {
+            start_ = std::chrono::steady_clock::now();
+            return true;
+        }
+
+        if (!checkBaseline(key_, samples_, tolerance_, file_, line_))
+            fprintf(stderr, "picotest: %s(%d): no baseline for '%s' yet; record one with --update_baselines\n",
+                file_, line_, key_.c_str());
+        return false;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(BaselineScope);
+
+    std::string key_;
+    double tolerance_;
+    const char* file_;
+    int line_;
+    std::size_t runs_;
+    std::chrono::steady_clock::time_point start_;
+    std::vector<double> samples_;
+};
+
+class TestCase {
+public:
+    // deque: tests never move once registered
+    typedef std::deque<Test> Tests;
+
+    typedef void (*FixtureFunc)(void);
+
+    TestCase() : executed_(false), set_up_(0), tear_down_(0), pending_(0), fixture_set_up_(false) {}
+    TestCase(const std::string& name) : executed_(false), name_(name), set_up_(0), tear_down_(0), pending_(0), fixture_set_up_(false) {}
+
+    void add(const Test&t) {
+        tests_.push_back(t);
+        tests_.back().setTestCase(this);
+    }
+
+    void add(const std::string& name, Test::TestFunc f, unsigned flags = 0) {
+        tests_.emplace_back(name, f, flags);
+        tests_.back().setTestCase(this);
+    }
+
+    template<typename Char, typename CharTraits>
+    void execute(std::basic_ostream<Char, CharTraits>& os) {
+        for (std::size_t i = 0; i < tests_.size(); i++)
+            if (tests_[i].enabled()) executeTest(i);
+
+        finish(os);
+    }
+
+    // runs a single test; safe to call concurrently for different indices
+    void executeTest(std::size_t index) {
+        beginTest(index);
+        tests_[index].execute();
+        endTest(index);
+    }
+
+    // a CO_TEST started on the event loop; finishCoroutineTest completes it once its body has
+    void startCoroutineTest(std::size_t index) {
+        beginTest(index);
+        tests_[index].startCoroutine();
+    }
+
+    void finishCoroutineTest(std::size_t index, double cpu_ns) {
+        TestState::setCurrentTestCase(this);
+        TestState::setCurrentTest(&tests_[index]);
+        tests_[index].finishCoroutine(cpu_ns);
+        endTest(index);
+    }
+
+    // the fixture's SetUpTestCase/TearDownTestCase, shared by all of its tests
+    void setFixture(FixtureFunc set_up, FixtureFunc tear_down) {
+        set_up_ = set_up;
+        tear_down_ = tear_down;
+    }
+
+    // counts the selected tests before a run: SetUpTestCase runs before the first of them starts
+    // and TearDownTestCase after the last one has finished, once, even if they run in parallel
+    void prepare() {
+        std::lock_guard<std::mutex> lock(fixture_mutex_);
+        pending_ = static_cast<std::size_t>(std::count_if(tests_.begin(), tests_.end(), std::mem_fn(&Test::enabled)));
+        fixture_set_up_ = false;
+    }
+
+    // forgets the results of the last iteration (see Test::reset)
+    void reset() {
+        executed_ = false;
+        for (std::size_t i = 0; i < tests_.size(); i++)
+            tests_[i].reset();
+    }
+
+    // for runs which end before every test has finished here (e.g. in a forked worker)
+    void tearDownFixture() {
+        std::lock_guard<std::mutex> lock(fixture_mutex_);
+        tearDownFixtureLocked();
+    }
+
+    // marks the testcase as executed once all of its tests have run
+    template<typename Char, typename CharTraits>
+    void finish(std::basic_ostream<Char, CharTraits>& os) {
+        executed_ = true;
+
+        if (!enabled()) return;
+
+        if (TestState::getReportMode() == TestReportForEach) {
+            report(os);
+            os.flush();
+        }
+        EventListeners::getInstance().testCaseEnd(*this);
+    }
+
+    std::size_t size() const {
+        return tests_.size();
+    }
+
+    Test& test(std::size_t index) {
+        return tests_[index];
+    }
+
+    const Test& test(std::size_t index) const {
+        return tests_[index];
+    }
+
+    // false if none of its tests is selected to run
+    bool enabled() const {
+        return std::find_if(tests_.begin(), tests_.end(), std::mem_fn(&Test::enabled)) != tests_.end();
+    }
+
+    template<typename Char, typename CharTraits>
+    void report(std::basic_ostream<Char, CharTraits>& os) const {
+        os << name_ << ":";
+
+        if (success())
+            detail::coloredPrint(os, detail::COLOR_GREEN, "[ PASSED ] ");
+        else
+            detail::coloredPrint(os, detail::COLOR_RED, "[ FAILED ] ");
+
+        if (TestState::getPrintTime())
+            os << "(wall " << detail::formatDuration(wallTime()) << ", cpu " << detail::formatDuration(cpuTime()) << ") ";
+
+        for (Tests::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+            if (!(*it).success()) (*it).reportFailure(os);
+
+        for (Tests::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+            if ((*it).hasBenchmark()) (*it).reportBenchmark(os);
+            else if ((*it).hasStress()) (*it).reportStress(os);
+            else if ((*it).perfCounts().available) (*it).reportPerfCounts(os);
+
+        os << "\n";
+    }
+
+    bool success() const {
+        return executed_ && std::all_of(tests_.begin(), tests_.end(), std::mem_fn(&Test::success));
+    }
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    // sums over the tests, i.e. the time it would take to run them one after another
+    double wallTime() const {
+        double ns = 0;
+        for (Tests::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it) ns += (*it).wallTime();
+        return ns;
+    }
+
+    double cpuTime() const {
+        double ns = 0;
+        for (Tests::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it) ns += (*it).cpuTime();
+        return ns;
+    }
+
+private:
+    void beginTest(std::size_t index) {
+        TestState::setCurrentTestCase(this);
+        TestState::setCurrentTest(&tests_[index]); // failures in SetUpTestCase go to the test which triggered it
+        setUpFixture();
+        EventListeners::getInstance().testStart(*this, tests_[index]);
+    }
+
+    void endTest(std::size_t index) {
+        EventListeners::getInstance().testEnd(*this, tests_[index]);
+
+        std::lock_guard<std::mutex> lock(fixture_mutex_);
+        if (pending_ > 0 && --pending_ == 0) tearDownFixtureLocked();
+    }
+
+    void setUpFixture() {
+        std::lock_guard<std::mutex> lock(fixture_mutex_); // other tests of this testcase wait for it
+        if (fixture_set_up_) return;
+        fixture_set_up_ = true;
+        if (set_up_) set_up_();
+    }
+
+    void tearDownFixtureLocked() {
+        if (!fixture_set_up_) return;
+        fixture_set_up_ = false;
+        pending_ = 0;
+        if (tear_down_) tear_down_();
+    }
+
+    bool executed_;
+    std::string name_;
+    Tests tests_;
+    FixtureFunc set_up_;
+    FixtureFunc tear_down_;
+    std::mutex fixture_mutex_;
+    std::size_t pending_;
+    bool fixture_set_up_;
+};
+
+class Environments {
+public:
+    static Environments& getInstance() {
+        static Environments instance;
+        return instance;
+    }
+
+    ~Environments() {
+        for (std::size_t i = 0; i < environments_.size(); i++)
+            delete environments_[i];
+    }
+
+    // takes ownership
+    Environment* append(Environment* env) {
+        environments_.push_back(env);
+        return env;
+    }
+
+    void setUp() {
+        for (std::size_t i = 0; i < environments_.size(); i++)
+            environments_[i]->SetUp();
+    }
+
+    void tearDown() {
+        for (std::size_t i = environments_.size(); i > 0; i--)
+            environments_[i - 1]->TearDown();
+    }
+
+private:
+    Environments() {}
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(Environments);
+
+    std::vector<Environment*> environments_;
+};
+
+/***** value-parameterized tests *****/
+
+// a TEST_P pattern under one instantiation becomes at most max(PARAM_TESTS_MIN, PARAM_TESTS_PER_JOB * jobs) tests:
+// one per instance while they are few, one per range of instances beyond that. so the registry does not grow
+// with the number of parameters, and the ranges still spread over the workers.
+const std::size_t PARAM_TESTS_MIN = 256;
+const std::size_t PARAM_TESTS_PER_JOB = 16;
+
+// "Name/7"
+inline std::string& paramInstanceName(const ParamRange& params, std::size_t index, std::string& name) {
+    return name.assign(params.test->test_name).append(1, '/').append(detail::toString(index));
+}
+
+// names the instance and its parameter in the failures recorded while it runs
+class ParamFailureContext : public FailureContext {
+public:
+    ParamFailureContext(const ParamRange& params, std::size_t index) : params_(params), index_(index) {
+        TestState::setFailureContext(this);
+    }
+
+    ~ParamFailureContext() {
+        TestState::setFailureContext(0);
+    }
+
+    // the test's name says which instance it is, unless it stands for several
+    virtual std::string describe() const {
+        const ParamInstantiationInfo& instantiation = *params_.instantiation;
+        std::string description;
+        if (params_.end - params_.begin > 1) paramInstanceName(params_, index_, description).append(", ");
+        return description + "GetParam() = " + instantiation.describe(instantiation.generator, index_);
+    }
+
+private:
+    const ParamRange& params_;
+    std::size_t index_;
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(ParamFailureContext);
+};
+
+// chooses among the instances a test stands for, by their names ("Prefix/Fixture.Name/7") or the test's
+// ("Prefix/Fixture.Name/0..99"). its strings are not charged to the test's allocations.
+class ParamInstanceFilter {
+public:
+    ParamInstanceFilter(const std::string& filter, const TestCase& testcase, const Test& test)
+        : filter_(std::string()), params_(test.params()) {
+        detail::AllocationTrackingPause pause;
+        filter_ = detail::TestFilter(filter);
+        group_name_.assign(testcase.name()).append(1, '.').append(test.name());
+        prefix_.assign(testcase.name()).append(1, '.').append(params_.test->test_name).append(1, '/');
+    }
+
+    bool selected(std::size_t index) {
+        if (filter_.matchesAll()) return true;
+
+        detail::AllocationTrackingPause pause;
+        name_.assign(prefix_).append(detail::toString(index));
+        return filter_.match(name_, group_name_);
+    }
+
+    bool anySelected() {
+        for (std::size_t i = params_.begin; i < params_.end; i++)
+            if (selected(i)) return true;
+        return false;
+    }
+
+private:
+    detail::TestFilter filter_;
+    const ParamRange& params_;
+    std::string group_name_;
+    std::string prefix_;
+    std::string name_;
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(ParamInstanceFilter);
+};
+
+// the body of a test made of a TEST_P: runs its instances in turn, each on a freshly constructed fixture
+inline void runParamTests() {
+    const Test& test = *TestState::getCurrentTest();
+    const ParamRange& params = test.params();
+    const ParamInstantiationInfo& instantiation = *params.instantiation;
+    ParamInstanceFilter filter(params.end - params.begin > 1 ? TestState::getFilter() : std::string(), *test.testCase(), test);
+
+    for (std::size_t i = params.begin; i < params.end; i++) {
+        if (!filter.selected(i)) continue;
+
+        ParamFailureContext context(params, i);
+        instantiation.run(instantiation.generator, i, params.test->func);
+    }
+}
+
+#ifdef PICOTEST_COROUTINES
+/***** event loop of CO_TEST *****/
+
+// the event loop looks at the deadlines of the CO_TESTs whenever it waits (at least every EVENT_LOOP_CHECK_MS),
+// and every EVENT_LOOP_CHECK_TURNS resumes for bodies which keep yielding
+const int EVENT_LOOP_CHECK_MS = 10;
+const std::size_t EVENT_LOOP_CHECK_TURNS = 1024;
+
+// a CO_TEST body handed to the event loop
+struct CoroutineTask {
+    std::coroutine_handle<> root;
+    Test* test;
+    TestCase* testcase;
+    std::chrono::steady_clock::time_point deadline; // of its timeout (max() if none)
+    double cpu_ns;                                  // of its own slices of the loop
+    bool done;
+};
+
+// interleaves CO_TEST bodies on the thread which runs it: a body runs until it awaits a timer, an Event or
+// yield(), then the next ready one is resumed. TestState's current test is switched at every resume, so
+// an assertion is attributed to the test whose body made it even though many are in progress at once.
+class EventLoop {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static EventLoop& getInstance() {
+        static thread_local EventLoop instance;
+        return instance;
+    }
+
+    // the steady clock, or with TestState::getFakeClock() one which stands still while the bodies run
+    // and jumps to the next timer once all of them wait
+    Clock::time_point now() const {
+        return TestState::getFakeClock() ? fake_now_ : Clock::now();
+    }
+
+    // while batched, spawned bodies wait for run(); otherwise each is run to completion as it is spawned
+    bool batched() const {
+        return batched_;
+    }
+
+    void setBatched(bool batched) {
+        batched_ = batched;
+    }
+
+    void spawn(std::coroutine_handle<> root, Test* test, TestCase* testcase) {
+        detail::AllocationTrackingPause pause;
+        const double timeout_ms = test->timeoutMs();
+        CoroutineTask task = { root, test, testcase, Clock::time_point::max(), 0, false };
+        if (timeout_ms > 0)
+            task.deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(timeout_ms));
+
+        tasks_.push_back(task);
+        pending_++;
+        post(root, &tasks_.back());
+    }
+
+    // the task being resumed (0 outside of the loop)
+    CoroutineTask* current() const {
+        return current_;
+    }
+
+    // resumes h, which belongs to task, on the next turn
+    void post(std::coroutine_handle<> h, CoroutineTask* task) {
+        detail::AllocationTrackingPause pause;
+        Ready ready = { h, task };
+        ready_.push_back(ready);
+    }
+
+    // resumes h, which belongs to task, once now() has reached when; timers due at the same time fire in order
+    void at(Clock::time_point when, std::coroutine_handle<> h, CoroutineTask* task) {
+        detail::AllocationTrackingPause pause;
+        Timer timer = { when, next_timer_++, h, task };
+        timers_.push(timer);
+    }
+
+    // runs until every spawned body has completed, timed out, or waits on something which can no longer happen;
+    // done(task) is called for each of them as it ends
+    template<typename Done>
+    void run(Done done) {
+        std::size_t turns = 0;
+
+        while (pending_ > 0) {
+            fireTimers();
+            if (ready_.empty() || ++turns % EVENT_LOOP_CHECK_TURNS == 0) expire(done);
+            if (ready_.empty()) {
+                if (pending_ == 0) break;
+                if (timers_.empty()) {
+                    abandon(done);
+                    break;
+                }
+                wait();
+                continue;
+            }
+
+            const Ready next = ready_.front();
+            ready_.pop_front();
+            if (!next.task->done) resume(next, done); // otherwise a stale wakeup of a body which timed out
+        }
+
+        detail::AllocationTrackingPause pause;
+        tasks_.clear();
+        ready_.clear();
+        timers_ = Timers();
+    }
+
+private:
+    struct Ready {
+        std::coroutine_handle<> handle;
+        CoroutineTask* task;
+    };
+
+    struct Timer {
+        Clock::time_point when;
+        uint64_t seq;
+        std::coroutine_handle<> handle;
+        CoroutineTask* task;
+    };
+
+    struct TimerLater {
+        bool operator()(const Timer& a, const Timer& b) const {
+            return a.when != b.when ? a.when > b.when : a.seq > b.seq;
+        }
+    };
+
+    typedef std::priority_queue<Timer, std::vector<Timer>, TimerLater> Timers;
+
+    EventLoop() : batched_(false), pending_(0), next_timer_(0), current_(0), fake_now_(Clock::now()) {}
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(EventLoop);
+
+    template<typename Done>
+    void resume(const Ready& next, Done& done) {
+        CoroutineTask& task = *next.task;
+        TestState::setCurrentTestCase(task.testcase);
+        TestState::setCurrentTest(task.test);
+        current_ = &task;
+        // a body which blocks instead of awaiting stops the whole loop: that is left to the watchdog
+        {
+            Watchdog::Guard watchdog(task.test, task.test->timeoutMs());
+            const double cpu_start = batched_ ? detail::threadCpuTimeNs() : 0;
+            next.handle.resume();
+            if (batched_) task.cpu_ns += detail::threadCpuTimeNs() - cpu_start;
+        }
+        current_ = 0;
+        if (task.root.done()) finish(task, done);
+    }
+
+    template<typename Done>
+    void finish(CoroutineTask& task, Done& done) {
+        task.root.destroy();
+        task.done = true;
+        pending_--;
+        done(task);
+    }
+
+    void fireTimers() {
+        const Clock::time_point current = now();
+        while (!timers_.empty() && timers_.top().when <= current) {
+            post(timers_.top().handle, timers_.top().task);
+            timers_.pop();
+        }
+    }
+
+    // nothing is ready: the fake clock jumps to the next timer, the real one sleeps until it (or a deadline)
+    void wait() {
+        const Clock::time_point next = timers_.top().when;
+        if (TestState::getFakeClock()) {
+            if (fake_now_ < next) fake_now_ = next;
+            return;
+        }
+        const Clock::time_point wake = std::min(next, Clock::now() + std::chrono::milliseconds(EVENT_LOOP_CHECK_MS));
+        std::this_thread::sleep_until(wake);
+    }
+
+    template<typename Done>
+    void expire(Done& done) {
+        const Clock::time_point current = Clock::now();
+        for (std::size_t i = 0; i < tasks_.size(); i++) {
+            CoroutineTask& task = tasks_[i];
+            if (task.done || current < task.deadline) continue;
+            fail(task, "timed out after " + detail::formatDuration(task.test->timeoutMs() * 1e6));
+            finish(task, done);
+        }
+    }
+
+    // no body is ready and no timer is left to wake one up
+    template<typename Done>
+    void abandon(Done& done) {
+        for (std::size_t i = 0; i < tasks_.size(); i++) {
+            CoroutineTask& task = tasks_[i];
+            if (task.done) continue;
+            fail(task, "never completed: it waits on an Event which nothing is left to set");
+            finish(task, done);
+        }
+    }
+
+    void fail(CoroutineTask& task, const std::string& message) {
+        TestState::setCurrentTestCase(task.testcase);
+        TestState::setCurrentTest(task.test);
+        task.test->addFailure(Failure::fromMessage("", 0, message));
+    }
+
+    bool batched_;
+    std::size_t pending_;
+    uint64_t next_timer_;
+    CoroutineTask* current_;
+    Clock::time_point fake_now_;
+    std::deque<CoroutineTask> tasks_; // deque: a task never moves while its handles are queued
+    std::deque<Ready> ready_;
+    Timers timers_;
+};
+#endif // ifdef PICOTEST_COROUTINES
+
+struct Registry {
+public:
+    // deque: testcases never move (or get copied) when another one is registered
+    typedef std::deque<TestCase> TestCases;
+
+    static Registry& getInstance() {
+        static Registry instance;
+        return instance;
+    }
+
+    void add(const std::string& test_case_name, const Test& t) {
+        find_or_add(test_case_name).add(t);
+    }
+
+    void add(const std::string& test_case_name, const std::string& test_name, Test::TestFunc f, unsigned flags = 0) {
+        find_or_add(test_case_name).add(test_name, f, flags);
+    }
+
+    // builds testcases/tests from the descriptors linked since the last call
+    void load() {
+        TestInfo* info = loaded_ ? loaded_->next : TestList::getInstance().head;
+
+        for (; info; info = info->next) {
+            TestCase& testcase = find_or_add(info->test_case_name);
+            testcase.add(info->test_name, info->func, info->flags);
+            testcase.test(testcase.size() - 1).setTimeoutMs(info->timeout_ms);
+            if (info->set_up_test_case || info->tear_down_test_case)
+                testcase.setFixture(info->set_up_test_case, info->tear_down_test_case);
+            loaded_ = info;
+        }
+
+        ParamInstantiationInfo* instantiation = loaded_params_ ? loaded_params_->next : ParamInstantiationList::getInstance().head;
+
+        for (; instantiation; instantiation = instantiation->next) {
+            loadParamTests(*instantiation);
+            loaded_params_ = instantiation;
+        }
+    }
+
+    // the tests of an INSTANTIATE_TEST_CASE_P, in testcase "Prefix/Fixture": "Name/7" for instance #7, or
+    // "Name/0..99" for a test standing for instances 0 to 99 (see PARAM_TESTS_MIN)
+    void loadParamTests(const ParamInstantiationInfo& instantiation) {
+        TestCase& testcase = find_or_add(std::string(instantiation.prefix) + "/" + instantiation.test_case_name);
+        testcase.setFixture(instantiation.set_up_test_case, instantiation.tear_down_test_case);
+
+        const std::size_t n = instantiation.size(instantiation.generator);
+        const std::size_t max_tests = std::max(PARAM_TESTS_MIN, PARAM_TESTS_PER_JOB * detail::resolveJobs(TestState::getJobs()));
+        const std::size_t per_test = (n + max_tests - 1) / max_tests;
+
+        for (const ParamTestInfo* info = instantiation.tests->head; info; info = info->next) {
+            for (std::size_t begin = 0; begin < n; begin += per_test) {
+                const ParamRange params = { &instantiation, info, begin, std::min(n, begin + per_test) };
+                std::string name;
+                paramInstanceName(params, begin, name);
+                if (params.end - params.begin > 1) name.append("..").append(detail::toString(params.end - 1));
+
+                testcase.add(name, &runParamTests);
+                testcase.test(testcase.size() - 1).setParams(params);
+            }
+        }
+    }
+
+    template<typename Char, typename CharTraits>
+    void testRun(std::basic_ostream<Char, CharTraits>& os) {
+        load();
+        selectTests();
+        seed_ = TestState::getRandomSeed() ? TestState::getRandomSeed() : detail::makeRandomSeed();
+        if (TestState::getShuffle())
+            os << "shuffling with seed " << seed_ << " (--picotest_random_seed=" << seed_ << " repeats this order)\n";
+
+        EventListeners::getInstance().runStart(*this);
+        Environments::getInstance().setUp();
+#ifdef PICOTEST_POSIX
+        if (TestState::getRepeatUntilFail())
+            repeatUntilFail(os);
+        else
+#endif
+        if (TestState::getRepeat() > 1 || TestState::getRepeatUntilFail())
+            repeat(os);
+        else
+            runOnce(os, 0);
+        Environments::getInstance().tearDown();
+        EventListeners::getInstance().runEnd(*this);
+    }
+
+    // prints the tests selected to run, in the format of --gtest_list_tests
+    template<typename Char, typename CharTraits>
+    void listTests(std::basic_ostream<Char, CharTraits>& os) {
+        load();
+        selectTests();
+
+        for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it) {
+            if (!(*it).enabled()) continue;
+
+            os << (*it).name() << ".\n";
+            for (std::size_t t = 0; t < (*it).size(); t++)
+                if ((*it).test(t).enabled()) os << "  " << (*it).test(t).name() << "\n";
+        }
+    }
+
+    // whether a test selected to run may be stopped by the watchdog
+    bool hasTimeouts() const {
+        for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+            for (std::size_t t = 0; t < (*it).size(); t++)
+                if ((*it).test(t).enabled() && (*it).test(t).timeoutMs() > 0) return true;
+        return false;
+    }
+
+    // number of tests selected to run
+    std::size_t numTests() const {
+        std::size_t n = 0;
+        for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+            for (std::size_t t = 0; t < (*it).size(); t++)
+                if ((*it).test(t).enabled()) n++;
+        return n;
+    }
+
+    const TestCases& testCases() const {
+        return tests_;
+    }
+
+    template<typename Char, typename CharTraits>
+    void report(std::basic_ostream<Char, CharTraits>& os) const {
+        if (iterations_ > 1) {
+            reportRuns(os);
+            return;
+        }
+        if (!run_error_.empty()) os << run_error_ << "\n";
+
+        std::size_t failed = numFailed();
+
+        if (failed) {
+            os << numFailed() << " of " << numTotal() << " tests failed.\n";
+
+            for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+                if ((*it).enabled() && !(*it).success()) (*it).report(os);
+        } else {
+            os << numSuccess() << " tests success.\n";
+        }
+
+        reportSlowest(os, TestState::getSlowestTests());
+    }
+
+    template<typename Char, typename CharTraits>
+    void reportSlowest(std::basic_ostream<Char, CharTraits>& os, std::size_t n) const {
+        typedef std::pair<const TestCase*, const Test*> Entry;
+        std::vector<Entry> executed;
+
+        for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+            for (std::size_t t = 0; t < (*it).size(); t++)
+                if ((*it).test(t).enabled()) executed.push_back(Entry(&*it, &(*it).test(t)));
+
+        n = std::min(n, executed.size());
+        if (n == 0) return;
+
+        std::partial_sort(executed.begin(), executed.begin() + n, executed.end(), [](const Entry& a, const Entry& b) {
+            return a.second->wallTime() > b.second->wallTime();
+        });
+
+        os << "slowest " << n << " tests:\n";
+        for (std::size_t i = 0; i < n; i++) {
+            os << "  " << std::setw(12) << detail::formatDuration(executed[i].second->wallTime())
+               << " (cpu " << detail::formatDuration(executed[i].second->cpuTime()) << ")  "
+               << executed[i].first->name() << "." << executed[i].second->name() << "\n";
+        }
+    }
+
+    // failure rate of each test which failed in some of the --repeat iterations
+    template<typename Char, typename CharTraits>
+    void reportRuns(std::basic_ostream<Char, CharTraits>& os) const {
+        if (!run_error_.empty()) os << run_error_ << "\n";
+        std::size_t total = 0, flaky = 0;
+
+        for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it) {
+            for (std::size_t t = 0; t < (*it).size(); t++) {
+                const Test& test = (*it).test(t);
+                if (!test.enabled()) continue;
+                total++;
+                if (test.failedRuns() == 0) continue;
+                flaky++;
+                os << (*it).name() << ".";
+                test.reportRuns(os, seed_);
+            }
+        }
+
+        if (flaky)
+            os << flaky << " of " << total << " tests failed in some of " << iterations_ << " runs.\n";
+        else
+            os << total << " tests passed " << iterations_ << " runs.\n";
+    }
+
+    bool fail() const {
+        if (!run_error_.empty()) return true;
+        if (iterations_ > 1) {
+            for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+                for (std::size_t t = 0; t < (*it).size(); t++)
+                    if ((*it).test(t).failedRuns() > 0) return true;
+            return false;
+        }
+        return numTotal() > 0 && numFailed() > 0;
+    }
+
+    std::size_t numFailed() const {
+        return numTotal() - numSuccess();
+    }
+
+    std::size_t numSuccess() const {
+        std::size_t n = 0;
+        for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
+            if ((*it).enabled() && (*it).success()) n++;
+        return n;
+    }
+
+    std::size_t numTotal() const {
+        return std::count_if(tests_.begin(), tests_.end(), std::mem_fn(&TestCase::enabled));
+    }
+
+private:
+    Registry() : reported_(0), loaded_(0), loaded_params_(0), seed_(0), iterations_(1), run_seed_(0) {}
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(Registry);
+
+    template<typename Char, typename CharTraits>
+    void runTests(std::basic_ostream<Char, CharTraits>& os) {
+#ifdef PICOTEST_POSIX
+        if (TestState::getProcessIsolation()) {
+            testRunIsolated(os);
+            return;
+        }
+#endif
+        if (detail::resolveJobs(TestState::getJobs()) == 1 && (TestState::getShuffle() || hasCoroutines())) {
+            std::vector<std::size_t> others, coroutines;
+            buildSchedule();
+            splitSchedule(others, others, &coroutines);
+            runCoroutines(coroutines, os);
+            runSerial(others, os);
+            finishAll(os);
+        } else if (detail::resolveJobs(TestState::getJobs()) == 1) {
+            for (TestCases::iterator it = tests_.begin(); it != tests_.end(); ++it)
+                it->execute(os);
+        } else {
+            testRunParallel(os);
+        }
+    }
+
+    // one pass over the selected tests; iteration i of --repeat shuffles with seed_ + i
+    template<typename Char, typename CharTraits>
+    void runOnce(std::basic_ostream<Char, CharTraits>& os, std::size_t iteration) {
+        run_seed_ = seed_ + static_cast<uint32_t>(iteration);
+        Watchdog::runStarted(numTests());
+        detail::drainOnFlush() = hasTimeouts();
+        for (TestCases::iterator it = tests_.begin(); it != tests_.end(); ++it) {
+            it->reset();
+            it->prepare();
+        }
+        runTests(os);
+        for (TestCases::iterator it = tests_.begin(); it != tests_.end(); ++it)
+            it->tearDownFixture();
+        collectStrayFailures();
+    }
+
+    // failures of spawned threads which outlived the test they were bound to fail the run
+    void collectStrayFailures() {
+        const Test::Failures failures = takeStrayFailures();
+        for (Test::Failures::const_iterator it = failures.begin(), end = failures.end(); it != end; ++it) {
+            if (!run_error_.empty()) run_error_ += "\n";
+            run_error_ += "outside of any running test: ";
+            if (!(*it).file.empty()) run_error_ += (*it).file + "(" + detail::toString((*it).line) + "): ";
+            run_error_ += (*it).describe();
+        }
+    }
+
+    static Test::Failures takeStrayFailures() {
+        ThreadFailures& stray = strayThreadFailures();
+        std::lock_guard<std::mutex> lock(stray.mutex);
+        Test::Failures failures = stray.log.failures();
+        if (stray.log.dropped() > 0) {
+            failures.push_back(Failure::fromMessage("", 0, detail::toString(stray.log.dropped()) +
+                                                           " more failure(s) were not recorded"));
+        }
+        stray.log.clear();
+        return failures;
+    }
+
+    // --repeat: the per-testcase reports of each iteration are replaced by one line per iteration,
+    // and Registry::report summarizes the failure rate of each test
+    template<typename Char, typename CharTraits>
+    void repeat(std::basic_ostream<Char, CharTraits>& os) {
+        std::basic_ostream<Char, CharTraits> discard(0);
+        const std::size_t iterations = TestState::getRepeat() ? TestState::getRepeat() : static_cast<std::size_t>(-1);
+
+        for (iterations_ = 0; iterations_ < iterations; ) {
+            runOnce(discard, iterations_);
+
+            std::size_t total = 0, failed = 0;
+            for (TestCases::iterator it = tests_.begin(); it != tests_.end(); ++it) {
+                for (std::size_t t = 0; t < it->size(); t++) {
+                    Test& test = it->test(t);
+                    test.recordRun(iterations_);
+                    if (!test.enabled()) continue;
+                    total++;
+                    if (!test.success()) failed++;
+                }
+            }
+            iterations_++;
+
+            os << "run " << iterations_;
+            if (iterations != static_cast<std::size_t>(-1)) os << "/" << iterations;
+            if (TestState::getShuffle()) os << " (seed " << run_seed_ << ")";
+            os << ": " << failed << " of " << total << " tests failed\n";
+            os.flush();
+            if (failed && TestState::getRepeatUntilFail()) break;
+        }
+    }
+
+    typedef std::pair<std::size_t, std::size_t> ScheduledTest; // (testcase, test)
+
+    // applies the filter, then sharding: the i-th remaining test in registration order runs on shard (i % total).
+    // deselected tests are never executed, so their fixtures are never constructed.
+    void selectTests() {
+        const detail::TestFilter filter(TestState::getFilter());
+        std::size_t index = 0, total = 1, i = 0;
+        const bool sharded = detail::getShard(index, total);
+        std::string full_name;
+
+        for (TestCases::iterator it = tests_.begin(); it != tests_.end(); ++it) {
+            for (std::size_t t = 0; t < it->size(); t++) {
+                Test& test = it->test(t);
+                bool enabled = true;
+
+                if (!filter.matchesAll()) {
+                    full_name.assign(it->name()).append(1, '.').append(test.name());
+                    enabled = test.params().end - test.params().begin > 1
+                            ? ParamInstanceFilter(TestState::getFilter(), *it, test).anySelected()
+                            : filter.match(full_name);
+                }
+                if (enabled && sharded)
+                    enabled = i++ % total == index;
+                test.setEnabled(enabled);
+            }
+        }
+    }
+
+    // with --shuffle, the testcases and the tests within each are permuted (as googletest does,
+    // so that a fixture's tests still run together); reports stay in registration order
+    void buildSchedule() {
+        std::mt19937 rng(run_seed_);
+        std::vector<std::size_t> cases, order;
+
+        schedule_.clear();
+        remaining_.assign(tests_.size(), 0);
+        reported_ = 0;
+
+        for (std::size_t c = 0; c < tests_.size(); c++)
+            cases.push_back(c);
+        if (TestState::getShuffle()) detail::shuffle(cases, rng);
+
+        for (std::size_t i = 0; i < cases.size(); i++) {
+            const std::size_t c = cases[i];
+            order.clear();
+            for (std::size_t t = 0; t < tests_[c].size(); t++)
+                if (tests_[c].test(t).enabled()) order.push_back(t);
+            if (TestState::getShuffle()) detail::shuffle(order, rng);
+
+            for (std::size_t t = 0; t < order.size(); t++)
+                schedule_.push_back(ScheduledTest(c, order[t]));
+            remaining_[c] += order.size();
+        }
+    }
+
+    Test& scheduledTest(std::size_t task) {
+        return tests_[schedule_[task].first].test(schedule_[task].second);
+    }
+
+    // testcases are reported in registration order as soon as they and all of their predecessors have completed
+    template<typename Char, typename CharTraits>
+    void completed(std::size_t task, std::basic_ostream<Char, CharTraits>& os) {
+        --remaining_[schedule_[task].first];
+        for (; reported_ < tests_.size() && remaining_[reported_] == 0; reported_++)
+            tests_[reported_].finish(os);
+    }
+
+    template<typename Char, typename CharTraits>
+    void finishAll(std::basic_ostream<Char, CharTraits>& os) {
+        for (; reported_ < tests_.size(); reported_++)
+            tests_[reported_].finish(os);
+    }
+
+    // serial tests are held back and run alone once everything else has finished; given 'coroutines',
+    // CO_TESTs are set apart there to be interleaved on the event loop (see runCoroutines)
+    void splitSchedule(std::vector<std::size_t>& concurrent, std::vector<std::size_t>& serial,
+                       std::vector<std::size_t>* coroutines = 0) {
+        for (std::size_t task = 0; task < schedule_.size(); task++) {
+            const Test& test = scheduledTest(task);
+            if (test.serial()) serial.push_back(task);
+            else if (coroutines && test.coroutine()) coroutines->push_back(task);
+            else concurrent.push_back(task);
+        }
+    }
+
+    bool hasCoroutines() const {
+        for (TestCases::const_iterator it = tests_.begin(); it != tests_.end(); ++it)
+            for (std::size_t t = 0; t < it->size(); t++)
+                if (it->test(t).enabled() && it->test(t).coroutine()) return true;
+        return false;
+    }
+
+    // the CO_TESTs are all started on the event loop of this thread, then run interleaved; each one
+    // is finished and reported as soon as its body completes
+    template<typename Char, typename CharTraits>
+    void runCoroutines(const std::vector<std::size_t>& coroutines, std::basic_ostream<Char, CharTraits>& os) {
+#ifdef PICOTEST_COROUTINES
+        if (coroutines.empty()) return;
+
+        EventLoop& loop = EventLoop::getInstance();
+        std::unordered_map<const Test*, std::size_t> tasks;
+
+        for (std::size_t i = 0; i < coroutines.size(); i++)
+            tasks[&scheduledTest(coroutines[i])] = coroutines[i];
+
+        loop.setBatched(true);
+        for (std::size_t i = 0; i < coroutines.size(); i++)
+            tests_[schedule_[coroutines[i]].first].startCoroutineTest(schedule_[coroutines[i]].second);
+        loop.run([&](CoroutineTask& coroutine) {
+            const std::size_t task = tasks[coroutine.test];
+            tests_[schedule_[task].first].finishCoroutineTest(schedule_[task].second, coroutine.cpu_ns);
+            completed(task, os);
+        });
+        loop.setBatched(false);
+#else
+        (void)coroutines; (void)os; // no CO_TEST without coroutines
+#endif
+    }
+
+    template<typename Char, typename CharTraits>
+    void runSerial(const std::vector<std::size_t>& serial, std::basic_ostream<Char, CharTraits>& os) {
+        for (std::size_t i = 0; i < serial.size(); i++) {
+            tests_[schedule_[serial[i]].first].executeTest(schedule_[serial[i]].second);
+            completed(serial[i], os);
+        }
+    }
+
+    // tests are scheduled individually on the work-stealing pool
+    template<typename Char, typename CharTraits>
+    void testRunParallel(std::basic_ostream<Char, CharTraits>& os) {
+        std::vector<std::size_t> concurrent, serial, coroutines;
+        std::mutex report_mutex;
+
+        buildSchedule();
+        splitSchedule(concurrent, serial, &coroutines);
+        runCoroutines(coroutines, os);
+
+        detail::parallelFor(concurrent.size(), TestState::getJobs(), [&](std::size_t i) {
+            // worker threads have no current test until their first one, so they would
+            // otherwise charge their bookkeeping to whichever test started last
+            detail::AllocationTrackingPause pause;
+            tests_[schedule_[concurrent[i]].first].executeTest(schedule_[concurrent[i]].second);
+
+            std::lock_guard<std::mutex> lock(report_mutex);
+            completed(concurrent[i], os);
+        });
+        runSerial(serial, os);
+        finishAll(os);
+    }
+
+#ifdef PICOTEST_POSIX
+    /***** process isolation *****/
+
+    // the parent sends task indices over 'request' and receives the serialized results over 'response'
+    struct Worker {
+        pid_t pid;
+        int request;
+        int response;
+        std::size_t task;
+        bool busy;
+        std::chrono::steady_clock::time_point deadline; // of the task, if it has a timeout
+    };
+
+    static std::string encodeResult(const Test& test) {
+        const Test::Failures& failures = test.failures();
+        detail::MessageWriter w;
+        w.put(test.wallTime());
+        w.put(test.cpuTime());
+        w.put(static_cast<uint32_t>(test.perfCounts().available));
+        for (int c = 0; c < detail::PerfCounterCount; c++)
+            w.put(test.perfCounts().values[c]);
+        w.put(static_cast<uint32_t>(failures.size()));
+        for (Test::Failures::const_iterator it = failures.begin(), end = failures.end(); it != end; ++it) {
+            w.put((*it).file);
+            w.put(static_cast<uint32_t>((*it).line));
+            w.put((*it).message);
+            w.put(static_cast<double>((*it).repeated));
+        }
+        return w.str();
+    }
+
+    static bool decodeResult(const std::string& payload, Test& test) {
+        detail::MessageReader r(payload);
+        uint32_t count, line;
+        double wall, cpu, repeated;
+        std::string file, message;
+
+        detail::PerfCounts perf;
+        if (!r.get(wall) || !r.get(cpu) || !r.get(count)) return false;
+        perf.available = count;
+        for (int c = 0; c < detail::PerfCounterCount; c++)
+            if (!r.get(perf.values[c])) return false;
+        if (!r.get(count)) return false;
+        test.setTime(wall, cpu);
+        test.setPerfCounts(perf);
+        for (uint32_t i = 0; i < count; i++) {
+            if (!r.get(file) || !r.get(line) || !r.get(message) || !r.get(repeated)) return false;
+            Failure failure = Failure::fromMessage(file, static_cast<int>(line), message);
+            failure.repeated = static_cast<std::size_t>(repeated);
+            test.addFailure(failure);
+        }
+        return true;
+    }
+
+    void spawnWorker(std::vector<Worker>& workers, std::size_t self) {
+        int request[2], response[2];
+
+        if (::pipe(request) != 0 || ::pipe(response) != 0) {
+            perror("picotest: pipe");
+            std::exit(1);
+        }
+
+        const pid_t pid = ::fork();
+        if (pid < 0) {
+            perror("picotest: fork");
+            std::exit(1);
+        }
+
+        if (pid == 0) {
+            ::close(request[1]);
+            ::close(response[0]);
+            // siblings must see EOF when the parent closes their pipes
+            for (std::size_t i = 0; i < workers.size(); i++) {
+                if (i == self || workers[i].pid <= 0) continue;
+                ::close(workers[i].request);
+                ::close(workers[i].response);
+            }
+            workerMain(request[0], response[1]);
+        }
+
+        ::close(request[0]);
+        ::close(response[1]);
+        Worker w = { pid, request[1], response[0], 0, false, std::chrono::steady_clock::time_point() };
+        workers[self] = w;
+    }
+
+    void workerMain(int request, int response) {
+        uint64_t task;
+
+        EventListeners::getInstance().abandon();
+        Watchdog::getInstance().setEnabled(false); // the parent enforces timeouts
+#ifdef PICOTEST_BACKTRACE
+        detail::installBacktraceHandler();
+#endif
+
+        while (detail::readAll(request, &task, sizeof(task))) {
+            tests_[schedule_[task].first].executeTest(schedule_[task].second);
+            // failures outside of any running test go to the test just run: this process reports no run
+            Test& test = tests_[schedule_[task].first].test(schedule_[task].second);
+            const Test::Failures stray = takeStrayFailures();
+            for (Test::Failures::const_iterator it = stray.begin(), end = stray.end(); it != end; ++it) {
+                Failure noted(*it);
+                noted.message = "outside of any running test: " + noted.message;
+                test.addFailure(noted);
+            }
+
+            std::cout.flush();
+            fflush(stdout);
+            if (!detail::writeMessage(response, encodeResult(scheduledTest(task)))) break;
+        }
+        for (TestCases::iterator it = tests_.begin(); it != tests_.end(); ++it)
+            it->tearDownFixture();
+        _exit(0);
+    }
+
+    bool assignTask(Worker& w, const std::vector<std::size_t>& tasks, std::size_t& next) {
+        if (next >= tasks.size()) return false;
+
+        const uint64_t task = tasks[next++];
+        w.task = static_cast<std::size_t>(task);
+        w.busy = true;
+        if (scheduledTest(w.task).timeoutMs() > 0)
+            w.deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(scheduledTest(w.task).timeoutMs()));
+        EventListeners::getInstance().testStart(tests_[schedule_[w.task].first], scheduledTest(w.task));
+        detail::writeAll(w.request, &task, sizeof(task)); // a dead worker is detected on the response pipe
+        return true;
+    }
+
+    static int retireWorker(Worker& w) {
+        int status = 0;
+        ::close(w.request);
+        ::close(w.response);
+        while (::waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {}
+        w.pid = -1;
+        w.busy = false;
+        return status;
+    }
+
+    // the worker died (or was killed) while running its task: the task fails and the worker is replaced
+    template<typename Char, typename CharTraits>
+    void failWorkerTask(std::vector<Worker>& workers, std::size_t self, std::size_t task, const std::string& message,
+                        const std::vector<std::size_t>& concurrent, std::size_t& next, std::basic_ostream<Char, CharTraits>& os) {
+        Test& test = scheduledTest(task);
+        test.setFailure(Failure::fromMessage("", 0, message));
+        test.setExecuted();
+        EventListeners::getInstance().testEnd(tests_[schedule_[task].first], test);
+        completed(task, os);
+        if (next < concurrent.size()) {
+            detail::flushNow(os);
+            std::cout.flush();
+            fflush(stdout);
+            spawnWorker(workers, self);
+            assignTask(workers[self], concurrent, next);
+        }
+    }
+
+    // milliseconds until the first busy worker runs out of time, -1 if none has a timeout
+    int timeUntilDeadline(const std::vector<Worker>& workers) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        int wait_ms = -1;
+
+        for (std::size_t i = 0; i < workers.size(); i++) {
+            if (!workers[i].busy || scheduledTest(workers[i].task).timeoutMs() <= 0) continue;
+            const double left = std::chrono::duration<double, std::milli>(workers[i].deadline - now).count();
+            const int ms = left > 0 ? static_cast<int>(std::ceil(left)) : 0;
+            if (wait_ms < 0 || ms < wait_ms) wait_ms = ms;
+        }
+        return wait_ms;
+    }
+
+    // a worker whose test outlived its timeout prints the test's backtrace and is killed
+    template<typename Char, typename CharTraits>
+    void killHungWorkers(std::vector<Worker>& workers, const std::vector<std::size_t>& concurrent, std::size_t& next,
+                         std::basic_ostream<Char, CharTraits>& os) {
+        for (std::size_t i = 0; i < workers.size(); i++) {
+            Worker& w = workers[i];
+            if (!w.busy || scheduledTest(w.task).timeoutMs() <= 0 || std::chrono::steady_clock::now() < w.deadline) continue;
+
+            const std::size_t task = w.task;
+            const std::string name = tests_[schedule_[task].first].name() + "." + scheduledTest(task).name();
+            const std::string message = "timed out after " + detail::formatDuration(scheduledTest(task).timeoutMs() * 1e6) + ", worker process killed";
+            fprintf(stderr, "picotest: %s %s\n", name.c_str(), message.c_str());
+#ifdef PICOTEST_BACKTRACE
+            ::kill(w.pid, detail::BACKTRACE_SIGNAL);
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+#endif
+            ::kill(w.pid, SIGKILL);
+            retireWorker(w);
+            failWorkerTask(workers, i, task, message, concurrent, next, os);
+        }
+    }
+
+    // a crash, abort or exit in a test body fails only that test; its worker is replaced,
+    // as is a worker which runs past the test's timeout.
+    // serial tests run in this process after the workers are done.
+    template<typename Char, typename CharTraits>
+    void testRunIsolated(std::basic_ostream<Char, CharTraits>& os) {
+        std::vector<std::size_t> concurrent, serial;
+
+        buildSchedule();
+        splitSchedule(concurrent, serial);
+
+        std::vector<Worker> workers(std::min(detail::resolveJobs(TestState::getJobs()), concurrent.size()));
+        std::size_t next = 0;
+
+        for (std::size_t i = 0; i < workers.size(); i++)
+            workers[i].pid = -1;
+
+        void (*old_sigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+        detail::flushNow(os);
+        std::cout.flush();
+        fflush(stdout);
+
+        for (std::size_t i = 0; i < workers.size(); i++) {
+            spawnWorker(workers, i);
+            assignTask(workers[i], concurrent, next);
+        }
+
+        for (;;) {
+            std::vector<pollfd> fds;
+            std::vector<std::size_t> owners;
+
+            for (std::size_t i = 0; i < workers.size(); i++) {
+                if (!workers[i].busy) continue;
+                pollfd fd = { workers[i].response, POLLIN, 0 };
+                fds.push_back(fd);
+                owners.push_back(i);
+            }
+            if (fds.empty()) break;
+
+            if (::poll(&fds[0], fds.size(), timeUntilDeadline(workers)) < 0) {
+                if (errno == EINTR) continue;
+                perror("picotest: poll");
+                std::exit(1);
+            }
+
+            for (std::size_t k = 0; k < fds.size(); k++) {
+                if (!fds[k].revents) continue;
+
+                Worker& w = workers[owners[k]];
+                const std::size_t task = w.task;
+                Test& test = scheduledTest(task);
+                std::string payload;
+
+                if (detail::readMessage(w.response, payload) && decodeResult(payload, test)) {
+                    test.setExecuted();
+                    EventListeners::getInstance().testEnd(tests_[schedule_[task].first], test);
+                    completed(task, os);
+                    if (!assignTask(w, concurrent, next)) retireWorker(w);
+                } else {
+                    const int status = retireWorker(w);
+                    failWorkerTask(workers, owners[k], task, detail::describeExitStatus(status), concurrent, next, os);
+                }
+            }
+            killHungWorkers(workers, concurrent, next, os);
+        }
+
+        signal(SIGPIPE, old_sigpipe);
+        runSerial(serial, os);
+        finishAll(os);
+    }
+
+    /***** --repeat_until_fail *****/
+
+    // runs 'first', 'first + step', ... until one fails; a message per run tells the parent the run index,
+    // whether it failed and, for a failed run or the last one of the worker, the results of all its tests
+    void untilFailWorker(int response, std::size_t first, std::size_t step, std::size_t limit) {
+        std::ostream discard(0);
+
+        EventListeners::getInstance().abandon();
+        TestState::setJobs(1);
+        TestState::setProcessIsolation(false);
+
+        for (std::size_t run = first; run < limit; run += step) {
+            std::vector<ScheduledTest> ran;
+            bool failed = false;
+            runOnce(discard, run);
+            for (std::size_t c = 0; c < tests_.size(); c++)
+                for (std::size_t t = 0; t < tests_[c].size(); t++) {
+                    if (!tests_[c].test(t).enabled()) continue;
+                    ran.push_back(ScheduledTest(c, t));
+                    failed |= !tests_[c].test(t).success();
+                }
+            if (!failed && limit - run > step) ran.clear(); // not the last run: only the outcome matters
+
+            detail::MessageWriter w;
+            w.put(static_cast<uint32_t>(run));
+            w.put(static_cast<uint32_t>(failed));
+            w.put(static_cast<uint32_t>(ran.size()));
+            for (std::size_t i = 0; i < ran.size(); i++) {
+                w.put(static_cast<uint32_t>(ran[i].first));
+                w.put(static_cast<uint32_t>(ran[i].second));
+                w.put(encodeResult(tests_[ran[i].first].test(ran[i].second)));
+            }
+            std::cout.flush();
+            fflush(stdout);
+            if (!detail::writeMessage(response, w.str()) || failed) break;
+        }
+        _exit(0);
+    }
+
+    void forgetRun(std::vector<ScheduledTest>& ran) {
+        for (std::size_t i = 0; i < ran.size(); i++)
+            tests_[ran[i].first].test(ran[i].second).reset();
+        ran.clear();
+    }
+
+    // restores the results of the tests of a run reported by untilFailWorker, replacing those of an earlier one
+    bool decodeRun(detail::MessageReader& r, uint32_t count, std::vector<ScheduledTest>& ran) {
+        uint32_t c, t;
+        std::string payload;
+
+        forgetRun(ran);
+        for (uint32_t i = 0; i < count; i++) {
+            if (!r.get(c) || !r.get(t) || !r.get(payload) || c >= tests_.size() || t >= tests_[c].size()) return false;
+            ran.push_back(ScheduledTest(c, t));
+            if (!decodeResult(payload, tests_[c].test(t))) return false;
+        }
+        return true;
+    }
+
+    // one worker process per job (per hardware thread, unless --picotest_jobs says otherwise) repeats
+    // the whole selection, worker k taking runs k, k + N, ... until a run fails or --repeat runs have passed.
+    // the first failed run is then reported here like an ordinary run, and the other workers are killed.
+    // if all of them pass, the last one is; only the tests of the reported run appear, with their own timings
+    template<typename Char, typename CharTraits>
+    void repeatUntilFail(std::basic_ostream<Char, CharTraits>& os) {
+        const std::size_t limit = TestState::getRepeat() ? TestState::getRepeat() : static_cast<std::size_t>(-1);
+        const std::size_t processes = std::min(detail::resolveJobs(TestState::getJobs() == 1 ? 0 : TestState::getJobs()), limit);
+        std::vector<Worker> workers(processes);
+        std::vector<ScheduledTest> ran; // of the reported run
+        std::size_t passed = 0, failed_run = 0, reported_run = 0;
+        bool failed = false;
+
+        void (*old_sigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+        detail::flushNow(os);
+        std::cout.flush();
+        fflush(stdout);
+
+        for (std::size_t k = 0; k < processes; k++) {
+            int response[2];
+            if (::pipe(response) != 0) {
+                perror("picotest: pipe");
+                std::exit(1);
+            }
+
+            const pid_t pid = ::fork();
+            if (pid < 0) {
+                perror("picotest: fork");
+                std::exit(1);
+            }
+            if (pid == 0) {
+                ::close(response[0]);
+                for (std::size_t i = 0; i < k; i++)
+                    ::close(workers[i].response);
+                untilFailWorker(response[1], k, processes, limit);
+            }
+
+            ::close(response[1]);
+            Worker w = { pid, -1, response[0], k, true, std::chrono::steady_clock::time_point() };
+            workers[k] = w;
+        }
+
+        while (!failed) {
+            std::vector<pollfd> fds;
+            std::vector<std::size_t> owners;
+
+            for (std::size_t i = 0; i < workers.size(); i++) {
+                if (!workers[i].busy) continue;
+                pollfd fd = { workers[i].response, POLLIN, 0 };
+                fds.push_back(fd);
+                owners.push_back(i);
+            }
+            if (fds.empty()) break;
+
+            if (::poll(&fds[0], fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                perror("picotest: poll");
+                std::exit(1);
+            }
+
+            for (std::size_t k = 0; k < fds.size() && !failed; k++) {
+                if (!fds[k].revents) continue;
+
+                Worker& w = workers[owners[k]];
+                std::string payload;
+                uint32_t run = 0, count = 0;
+
+                if (!detail::readMessage(w.response, payload)) {
+                    // done with its share, or died in the middle of run w.task
+                    const int status = retireWorker(w);
+                    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) continue;
+                    failed = true;
+                    failed_run = w.task;
+                    run_error_ = "run " + detail::toString(w.task + 1) + ": " + detail::describeExitStatus(status);
+                    forgetRun(ran); // the results of its tests died with it
+                    continue;
+                }
+
+                detail::MessageReader r(payload);
+                uint32_t run_failed = 0;
+                if (!r.get(run) || !r.get(run_failed) || !r.get(count)) continue;
+                if (!run_failed) {
+                    passed++;
+                    w.task = run + processes;
+                    if (count == 0 || run < reported_run) continue;
+                    reported_run = run;
+                } else {
+                    failed = true;
+                    failed_run = run;
+                }
+                if (!decodeRun(r, count, ran))
+                    run_error_ = "run " + detail::toString(run + 1) + ": malformed result from the worker process";
+            }
+        }
+
+        for (std::size_t i = 0; i < workers.size(); i++) {
+            if (!workers[i].busy) continue;
+            ::kill(workers[i].pid, SIGKILL);
+            retireWorker(workers[i]);
+        }
+        signal(SIGPIPE, old_sigpipe);
+
+        if (failed) {
+            os << "run " << failed_run + 1;
+            if (TestState::getShuffle()) os << " (seed " << seed_ + failed_run << ")";
+            os << " failed, after " << passed << " passing runs in " << processes << " processes\n";
+        } else {
+            os << passed << " runs passed in " << processes << " processes\n";
+        }
+
+        // the reported run is shown like an ordinary run; tests it did not get to are left out
+        for (std::size_t c = 0; c < tests_.size(); c++)
+            for (std::size_t t = 0; t < tests_[c].size(); t++)
+                if (std::find(ran.begin(), ran.end(), ScheduledTest(c, t)) == ran.end()) tests_[c].test(t).setEnabled(false);
+        for (std::size_t i = 0; i < ran.size(); i++) {
+            Test& test = tests_[ran[i].first].test(ran[i].second);
+            test.setExecuted();
+            EventListeners::getInstance().testEnd(tests_[ran[i].first], test);
+        }
+        finishAll(os);
+    }
+#endif
+
+    typedef std::unordered_map<std::string, std::size_t> Index; // testcase name -> position in tests_
+
+    TestCase& find_or_add(const std::string& test_case_name) {
+        std::pair<Index::iterator, bool> found = index_.insert(Index::value_type(test_case_name, tests_.size()));
+
+        if (found.second)
+            tests_.emplace_back(test_case_name);
+        return tests_[found.first->second];
+    }
+
+    TestCases tests_;
+    Index index_;
+    std::vector<ScheduledTest> schedule_;
+    std::vector<std::size_t> remaining_;
+    std::size_t reported_;
+    TestInfo* loaded_;
+    ParamInstantiationInfo* loaded_params_;
+    uint32_t seed_;          // of the first iteration
+    std::size_t iterations_; // completed --repeat iterations
+    uint32_t run_seed_;      // of the current iteration
+    std::string run_error_;  // a failure outside of any test (a --repeat_until_fail worker died)
+};
+
+struct Registrar {
+    Registrar (const std::string& test_case_name, const Test& t) {
+        Registry::getInstance().add(test_case_name, t);
+    }
+
+    Registrar (const char* test_case_name, const char* test_name, Test::TestFunc f) {
+        Registry::getInstance().add(test_case_name, test_name, f);
+    }
+};
+
+inline uint64_t Watchdog::watch(Test* test, double timeout_ms) {
+    if (!enabled_) return 0;
+
+    detail::AllocationTrackingPause pause;
+    Entry entry;
+    snprintf(entry.message, sizeof(entry.message), "picotest: %s%s%s timed out after %s, run aborted\n",
+             test->testCase() ? test->testCase()->name().c_str() : "", test->testCase() ? "." : "",
+             test->name().c_str(), detail::formatDuration(timeout_ms * 1e6).c_str());
+    entry.deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(timeout_ms));
+#ifdef PICOTEST_POSIX
+    entry.thread = pthread_self();
+#endif
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_) {
+        started_ = true;
+#ifdef PICOTEST_BACKTRACE
+        detail::installBacktraceHandler();
+#endif
+        std::thread(&Watchdog::run, this).detach();
+    }
+
+    entry.id = next_id_++;
+    entries_.push_back(entry);
+    changed_.notify_one();
+    return entry.id;
+}
+
+// a test hung outside of a worker process: the run cannot go on. the hung thread may hold any lock (of the
+// output, the listeners, the failure logs or the allocator), so nothing of the framework is touched: the message
+// formatted by watch, the backtrace and a summary of the progress counters are written, and the process exits
+// without listeners (the reports end with the last finished testcase) or static destructors
+inline void Watchdog::expire(const Entry& entry) {
+    writeRaw(2, entry.message, strlen(entry.message));
+#ifdef PICOTEST_BACKTRACE
+    detail::printBacktrace(entry.thread);
+#endif
+
+    char summary[128];
+    const int n = snprintf(summary, sizeof(summary), "run aborted: %lu of %lu tests finished, %lu failed.\n",
+                           static_cast<unsigned long>(finishedTests() + 1), static_cast<unsigned long>(totalTests()),
+                           static_cast<unsigned long>(failedTests() + 1)); // the hung test included
+    if (n > 0) writeRaw(1, summary, std::min(static_cast<std::size_t>(n), sizeof(summary) - 1));
+    std::_Exit(1);
+}
+
+/***** reporters *****/
+
+inline std::string formatSeconds(double ns) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3) << ns / 1e9;
+    return os.str();
+}
+
+// JUnit XML, written one <testsuite> per testcase as soon as the testcase completes
+class JUnitReporter : public EventListener {
+public:
+    explicit JUnitReporter(FILE* file) : file_(file), os_(file) {}
+
+    ~JUnitReporter() {
+        os_.drain();
+        if (file_) fclose(file_);
+    }
+
+    void onRunStart(const Registry&) {
+        os_ << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n";
+    }
+
+    void onTestCaseEnd(const TestCase& testcase) {
+        std::size_t tests = 0, failures = 0;
+        for (std::size_t i = 0; i < testcase.size(); i++) {
+            if (!testcase.test(i).enabled()) continue;
+            tests++;
+            if (!testcase.test(i).success()) failures++;
+        }
+
+        os_ << "  <testsuite name=\"" << detail::escapeXml(testcase.name()) << "\" tests=\"" << tests
+            << "\" failures=\"" << failures << "\" time=\"" << formatSeconds(testcase.wallTime()) << "\">\n";
+
+        for (std::size_t i = 0; i < testcase.size(); i++) {
+            const Test& test = testcase.test(i);
+            if (!test.enabled()) continue;
+
+            os_ << "    <testcase name=\"" << detail::escapeXml(test.name()) << "\" classname=\""
+                << detail::escapeXml(testcase.name()) << "\" time=\"" << formatSeconds(test.wallTime()) << "\"";
+            if (test.failures().empty()) {
+                os_ << "/>\n";
+                continue;
+            }
+
+            os_ << ">\n";
+            for (Test::Failures::const_iterator it = test.failures().begin(), end = test.failures().end(); it != end; ++it) {
+                os_ << "      <failure message=\"" << detail::escapeXml((*it).describe()) << "\">"
+                    << detail::escapeXml((*it).file) << ":" << (*it).line << "</failure>\n";
+            }
+            os_ << "    </testcase>\n";
+        }
+        os_ << "  </testsuite>\n";
+        os_.flush(); // rate-limited, see BufferedStreamBuf
+    }
+
+    void onRunEnd(const Registry&) {
+        os_ << "</testsuites>\n";
+        os_.drain();
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(JUnitReporter);
+
+    FILE* file_;
+    detail::BufferedOStream os_;
+};
+
+// newline-delimited JSON: one record when the run starts, one per test as it ends, one when the run ends
+class JsonReporter : public EventListener {
+public:
+    explicit JsonReporter(FILE* file) : file_(file), os_(file) {}
+
+    ~JsonReporter() {
+        os_.drain();
+        if (file_) fclose(file_);
+    }
+
+    void onRunStart(const Registry& registry) {
+        os_ << "{\"event\":\"run_start\",\"tests\":" << registry.numTests() << "}\n";
+    }
+
+    void onTestEnd(const TestCase& testcase, const Test& test) {
+        os_ << "{\"event\":\"test_end\",\"testcase\":\"" << detail::escapeJson(testcase.name())
+            << "\",\"test\":\"" << detail::escapeJson(test.name())
+            << "\",\"success\":" << (test.success() ? "true" : "false")
+            << ",\"wall_ns\":" << static_cast<uint64_t>(test.wallTime())
+            << ",\"cpu_ns\":" << static_cast<uint64_t>(test.cpuTime());
+
+        if (test.perfCounts().available) {
+            os_ << ",\"counters\":{";
+            for (int c = 0, n = 0; c < detail::PerfCounterCount; c++)
+                if (test.perfCounts().has(c))
+                    os_ << (n++ ? "," : "") << "\"" << detail::perfCounterName(c) << "\":" << static_cast<uint64_t>(test.perfCounts().values[c]);
+            os_ << "}";
+        }
+        os_ << ",\"failures\":[";
+
+        for (std::size_t i = 0; i < test.failures().size(); i++) {
+            const Failure& f = test.failures()[i];
+            os_ << (i ? "," : "") << "{\"file\":\"" << detail::escapeJson(f.file) << "\",\"line\":" << f.line
+                << ",\"message\":\"" << detail::escapeJson(f.message) << "\"";
+            if (f.repeated) os_ << ",\"repeated\":" << f.repeated;
+            os_ << "}";
+        }
+        os_ << "]}\n";
+        os_.flush(); // rate-limited, see BufferedStreamBuf
+    }
+
+    void onRunEnd(const Registry& registry) {
+        os_ << "{\"event\":\"run_end\",\"testcases\":" << registry.numTotal()
+            << ",\"failed_testcases\":" << registry.numFailed() << "}\n";
+        os_.drain();
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(JsonReporter);
+
+    FILE* file_;
+    detail::BufferedOStream os_;
+};
+
+// "xml:PATH" or "json:PATH", as given to --picotest_output
+inline bool addReporter(const std::string& spec) {
+    const std::string::size_type colon = spec.find(':');
+    const std::string format = spec.substr(0, colon);
+    const std::string path = colon == std::string::npos ? "" : spec.substr(colon + 1);
+
+    if ((format != "xml" && format != "json") || path.empty()) {
+        fprintf(stderr, "picotest: unsupported output '%s' (expected xml:PATH or json:PATH)\n", spec.c_str());
+        return false;
+    }
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        fprintf(stderr, "picotest: cannot open '%s' for writing\n", path.c_str());
+        return false;
+    }
+
+    if (format == "xml")
+        EventListeners::getInstance().append(new JUnitReporter(file));
+    else
+        EventListeners::getInstance().append(new JsonReporter(file));
+    return true;
+}
+
+} // namespace picotest::framework
+
+/***** bulk array comparison *****/
+
+// an array op counts the mismatching elements of two ranges in bulk (the SIMD kernels in detail),
+// and judges a single pair with operator() when describing a failure
+
+struct ARRAY_EQ {
+    template<typename T1, typename T2>
+    std::size_t count(const T1* expected, const T2* actual, std::size_t n) const {
+        return detail::countEqMismatches(expected, actual, n);
+    }
+    template<typename T1, typename T2>
+    bool operator()(const T1& expected, const T2& actual) const {
+        return expected == actual;
+    }
+    static std::string name() { return "=="; }
+};
+
+struct ARRAY_FLOATEQ {
+    template<typename T>
+    std::size_t count(const T* expected, const T* actual, std::size_t n) const {
+        return detail::countUlpMismatches(expected, actual, n);
+    }
+    template<typename T>
+    bool operator()(const T& expected, const T& actual) const {
+        return detail::Floating::almostEqual(expected, actual);
+    }
+    static std::string name() { return "=="; }
+};
+
+struct ARRAY_NEAR {
+    explicit ARRAY_NEAR(double abs_error) : abs_error_(abs_error) {}
+
+    template<typename T1, typename T2>
+    std::size_t count(const T1* expected, const T2* actual, std::size_t n) const {
+        return detail::countNearMismatches(expected, actual, n, abs_error_);
+    }
+    template<typename T1, typename T2>
+    bool operator()(const T1& expected, const T2& actual) const {
+        return detail::absDifference(expected, actual) <= abs_error_;
+    }
+    static std::string name() { return "=="; }
+private:
+    double abs_error_;
+};
+
+template<typename T1, typename T2, typename OP>
+bool compare_array(const T1* expected, const T2* actual, std::size_t n, OP op,
+                   const char* expected_str, const char* actual_str, const char* file, int line) {
+    const std::size_t mismatches = op.count(expected, actual, n);
+
+    if (mismatches != 0) {
+        if (framework::countFailure(file, line)) framework::addFailure(
+            framework::Failure(file, line,
+            std::string(expected_str) + "[0.." + detail::toString(n) + ") " + op.name() + " " + actual_str + "[0.." + detail::toString(n) + ")",
+            detail::describeArrayMismatches(expected, actual, n, mismatches, op)));
+    }
+    return mismatches == 0;
+}
+
+/***** latency histograms *****/
+
+// durations in ns, counted in fixed log-linear buckets like an HDR histogram: values below 256 ns are exact,
+// larger ones keep 8 significant bits (within 0.8%). record() is O(1) and never allocates.
+// not synchronized; give each thread its own and add() them up.
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts_(BUCKETS, 0) {
+        clear();
+    }
+
+    void record(uint64_t ns) {
+        counts_[bucket(ns)]++;
+        count_++;
+        sum_ += static_cast<double>(ns);
+        if (ns < min_) min_ = ns;
+        if (ns > max_) max_ = ns;
+    }
+
+    template<typename Rep, typename Period>
+    void record(const std::chrono::duration<Rep, Period>& d) {
+        const double ns = detail::toNanoseconds(d);
+        record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    }
+
+    void add(const LatencyHistogram& other) {
+        for (std::size_t i = 0; i < BUCKETS; i++) counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void clear() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        count_ = 0;
+        sum_ = 0;
+        min_ = std::numeric_limits<uint64_t>::max();
+        max_ = 0;
+    }
+
+    uint64_t count() const {
+        return count_;
+    }
+
+    uint64_t min() const {
+        return count_ ? min_ : 0;
+    }
+
+    uint64_t max() const {
+        return max_;
+    }
+
+    double mean() const {
+        return count_ ? sum_ / count_ : 0;
+    }
+
+    // the value which 'percentile'% of the recorded ones are at or below, rounded up to the end of its bucket
+    uint64_t valueAtPercentile(double percentile) const {
+        if (count_ == 0) return 0;
+
+        const double rank = std::ceil(percentile / 100 * count_ - 1e-9);
+        const uint64_t target = rank < 1 ? 1 : static_cast<uint64_t>(rank);
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; i++) {
+            seen += counts_[i];
+            if (seen >= target) return std::max(min_, std::min(max_, highestInBucket(i)));
+        }
+        return max_;
+    }
+
+    // a table of percentiles from the median out to the maximum, in steps of 50, 75, 90, 95, 99, 99.5, 99.9, ...
+    // for as long as some values lie above them
+    std::string spectrum() const {
+        std::ostringstream os;
+        os << "  " << std::setw(12) << "percentile" << std::setw(16) << "value" << "\n";
+
+        const double steps[] = { 50, 75, 90, 95 };
+        for (std::size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+            spectrumRow(os, steps[i]);
+        for (double tail = 1; tail * count_ / 100 >= 1; tail /= 10) {
+            spectrumRow(os, 100 - tail);
+            if (tail / 2 * count_ / 100 >= 1) spectrumRow(os, 100 - tail / 2);
+        }
+        spectrumRow(os, 100);
+
+        os << "  " << count_ << " values, min " << detail::formatDuration(static_cast<double>(min()))
+           << ", mean " << detail::formatDuration(mean()) << ", max " << detail::formatDuration(static_cast<double>(max_));
+        return os.str();
+    }
+
+private:
+    static const unsigned SIGNIFICANT_BITS = 8;
+    static const std::size_t SUB_BUCKETS = std::size_t(1) << SIGNIFICANT_BITS;
+    static const std::size_t BUCKETS = SUB_BUCKETS + (64 - SIGNIFICANT_BITS) * (SUB_BUCKETS / 2);
+
+    // values with their highest bit at b >= SIGNIFICANT_BITS share buckets of width 2^(b - SIGNIFICANT_BITS + 1)
+    static std::size_t bucket(uint64_t ns) {
+        if (ns < SUB_BUCKETS) return static_cast<std::size_t>(ns);
+
+        const unsigned shift = detail::highestBit(ns) - (SIGNIFICANT_BITS - 1);
+        return SUB_BUCKETS + (shift - 1) * (SUB_BUCKETS / 2) + static_cast<std::size_t>(ns >> shift) - SUB_BUCKETS / 2;
+    }
+
+    static uint64_t highestInBucket(std::size_t index) {
+        if (index < SUB_BUCKETS) return index;
+
+        const std::size_t k = index - SUB_BUCKETS;
+        const unsigned shift = static_cast<unsigned>(k / (SUB_BUCKETS / 2)) + 1;
+        const uint64_t mantissa = SUB_BUCKETS / 2 + k % (SUB_BUCKETS / 2);
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    void spectrumRow(std::ostringstream& os, double percentile) const {
+        os << "  " << std::setw(12) << detail::toString(percentile)
+           << std::setw(16) << detail::formatDuration(static_cast<double>(valueAtPercentile(percentile))) << "\n";
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    double sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+// 'limit' is a std::chrono duration or a number of ns
+template<typename Limit>
+bool compare_percentile(const LatencyHistogram& hist, double percentile, const Limit& limit,
+                        const char* hist_str, const char* limit_str, const char* file, int line) {
+    const double limit_ns = detail::toNanoseconds(limit);
+    const uint64_t value = hist.valueAtPercentile(percentile);
+    const bool test_success = hist.count() > 0 && value <= limit_ns;
+
+    if (!test_success) {
+        if (framework::countFailure(file, line)) framework::addFailure(
+            framework::Failure(file, line,
+            "percentile " + detail::toString(percentile) + " of " + hist_str + " <= " + limit_str,
+            hist.count() == 0 ? std::string("no values recorded") :
+            detail::formatDuration(static_cast<double>(value)) + " <= " + detail::formatDuration(limit_ns) + "\n" + hist.spectrum()));
+    }
+    return test_success;
+}
+
+} // namespace picotest
+
+// using namespace benchmark for compatibility with google benchmark
+namespace benchmark {
+
+// passed to a BENCHMARK body, which must loop while KeepRunning() returns true:
+//
+//   BENCHMARK(String, Copy) {
+//       std::string src(1000, 'x');
+//       while (state.KeepRunning()) {
+//           std::string copy(src);
+//           benchmark::DoNotOptimize(copy);
+//       }
+//   }
+class State {
+public:
+    explicit State(std::size_t iterations)
+        : iterations_(iterations), remaining_(0), started_(false), finished_(false), elapsed_ns_(0), cycles_(0),
+          perf_enabled_(picotest::framework::TestState::getPerfCounters()) {}
+
+    bool KeepRunning() {
+        if (remaining_ != 0) {
+            --remaining_;
+            return true;
+        }
+        return startOrStop();
+    }
+
+    // for (auto _ : state) { ... }
+    struct Value {
+        ~Value() {} // non-trivial, so that an unused loop variable does not warn
+    };
+
+    struct iterator {
+        State* state;
+        bool operator!=(const iterator&) const { return state->KeepRunning(); }
+        iterator& operator++() { return *this; }
+        Value operator*() const { return Value(); }
+    };
+
+    iterator begin() { iterator it = { this }; return it; }
+    iterator end()   { iterator it = { this }; return it; }
+
+    std::size_t iterations() const {
+        return iterations_;
+    }
+
+    bool finished() const {
+        return finished_;
+    }
+
+    double elapsedNs() const {
+        return elapsed_ns_;
+    }
+
+    double cycles() const {
+        return static_cast<double>(cycles_);
+    }
+
+    // hardware counters over the timed loop, if enabled by --picotest_perf_counters
+    const picotest::detail::PerfCounts& perfCounts() const {
+        return perf_;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(State);
+
+    typedef std::chrono::steady_clock Clock;
+
+    bool startOrStop() {
+        if (!started_ && iterations_ > 0) {
+            started_ = true;
+            remaining_ = iterations_ - 1;
+            if (perf_enabled_) perf_start_ = picotest::detail::PerfCounterGroup::forThisThread().read();
+            start_cycles_ = picotest::detail::readCycleCounter();
+            start_ = Clock::now();
+            return true;
+        }
+        if (started_ && !finished_) {
+            const Clock::time_point end = Clock::now();
+            cycles_ = picotest::detail::readCycleCounter() - start_cycles_;
+            elapsed_ns_ = std::chrono::duration<double, std::nano>(end - start_).count();
+            if (perf_enabled_) perf_ = picotest::detail::PerfCounterGroup::forThisThread().read().since(perf_start_);
+            finished_ = true;
+        }
+        return false;
+    }
+
+    std::size_t iterations_;
+    std::size_t remaining_;
+    bool started_;
+    bool finished_;
+    Clock::time_point start_;
+    uint64_t start_cycles_;
+    double elapsed_ns_;
+    uint64_t cycles_;
+    bool perf_enabled_;
+    picotest::detail::PerfCounts perf_start_;
+    picotest::detail::PerfCounts perf_;
+};
+
+// forces 'value' to be materialized, so the computation producing it cannot be optimized away
+template<typename T>
+inline void DoNotOptimize(T const& value) {
+#ifdef __GNUC__
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    picotest::detail::useCharPointer(&reinterpret_cast<char const volatile&>(value));
+    _ReadWriteBarrier();
+#endif
+}
+
+// forces all pending writes to memory
+inline void ClobberMemory() {
+#ifdef __GNUC__
+    asm volatile("" : : : "memory");
+#else
+    _ReadWriteBarrier();
+#endif
+}
+
+} // namespace benchmark
+
+namespace picotest {
+
+// passed to a STRESS_TEST body, which runs on each of its threads and loops while KeepRunning() returns true:
+//
+//   STRESS_TEST(Queue, PushPop, 8, 100000) {
+//       while (state.KeepRunning()) {
+//           queue.push(state.threadIndex());
+//           EXPECT_TRUE(queue.pop());
+//       }
+//   }
+class StressState {
+public:
+    // runs for 'iterations', or until 'stop' is set if that is given
+    StressState(std::size_t thread_index, std::size_t threads, uint64_t iterations, const std::atomic<bool>* stop)
+        : thread_index_(thread_index), threads_(threads), limit_(iterations), iterations_(0), stop_(stop) {}
+
+    bool KeepRunning() {
+        if (stop_ ? stop_->load(std::memory_order_relaxed) : iterations_ == limit_) return false;
+        ++iterations_;
+        return true;
+    }
+
+    // for (auto _ : state) { ... }
+    struct Value {
+        ~Value() {} // non-trivial, so that an unused loop variable does not warn
+    };
+
+    struct iterator {
+        StressState* state;
+        bool operator!=(const iterator&) const { return state->KeepRunning(); }
+        iterator& operator++() { return *this; }
+        Value operator*() const { return Value(); }
+    };
+
+    iterator begin() { iterator it = { this }; return it; }
+    iterator end()   { iterator it = { this }; return it; }
+
+    // 0 .. threads() - 1
+    std::size_t threadIndex() const {
+        return thread_index_;
+    }
+
+    std::size_t threads() const {
+        return threads_;
+    }
+
+    // started so far by this thread
+    uint64_t iterations() const {
+        return iterations_;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(StressState);
+
+    std::size_t thread_index_;
+    std::size_t threads_;
+    uint64_t limit_;
+    uint64_t iterations_;
+    const std::atomic<bool>* stop_;
+};
+
+namespace framework {
+
+// runs t.stress_method on 'threads' threads (0 = one per hardware thread), released together by a spin barrier,
+// for 'iterations' each or, if 0, for 'duration_ms'. the body's assertions go to the current test
+template<typename T>
+void runStress(T& t, std::size_t threads, uint64_t iterations, double duration_ms) {
+    const std::size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 0) threads = cpus;
+
+    Test* test = TestState::getCurrentTest();
+    const bool pin = TestState::getStressPinThreads();
+    detail::SpinBarrier barrier(threads + 1);
+    std::atomic<bool> stop(false);
+    StressResult result;
+    result.threads.resize(threads);
+    std::vector<std::chrono::steady_clock::time_point> starts(threads), ends(threads);
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; i++) {
+        workers.push_back(std::thread([&, i] {
+            AdoptTest adopt(test);
+            StressResult::Thread& r = result.threads[i];
+            if (pin && detail::pinThread(static_cast<unsigned>(i % cpus))) r.cpu = static_cast<int>(i % cpus);
+
+            ::picotest::StressState state(i, threads, iterations, iterations ? 0 : &stop);
+            barrier.wait();
+            starts[i] = std::chrono::steady_clock::now();
+            t.stress_method(state);
+            ends[i] = std::chrono::steady_clock::now();
+            r.ns = std::chrono::duration<double, std::nano>(ends[i] - starts[i]).count();
+            r.iterations = state.iterations();
+
+            detail::AllocationTrackingPause pause;
+            r.failures = threadFailures().log.total();
+        }));
+    }
+
+    barrier.wait();
+    if (iterations == 0) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(duration_ms));
+        stop.store(true, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    result.ns = std::chrono::duration<double, std::nano>(
+        *std::max_element(ends.begin(), ends.end()) - *std::min_element(starts.begin(), starts.end())).count();
+    test->setStress(result);
+}
+
+typedef void (*BenchmarkFunc)(::benchmark::State&);
+
+inline bool runBenchmarkBatch(BenchmarkFunc f, std::size_t iterations, double& ns, double& cycles, detail::PerfCounts& perf) {
+    ::benchmark::State state(iterations);
+    f(state);
+    ns = state.elapsedNs();
+    cycles = state.cycles();
+    perf = state.perfCounts();
+    return state.finished();
+}
+
+// scales the iteration count until one batch takes the minimum sample time,
+// then records TestState::getBenchmarkSamples() batches to the current test
+inline void runBenchmark(BenchmarkFunc f, const char* file, int line) {
+    const double min_ns = TestState::getBenchmarkMinTimeMs() * 1e6;
+    std::size_t iterations = 1;
+    double ns, cycles;
+    detail::PerfCounts perf;
+
+    for (;;) {
+        if (!runBenchmarkBatch(f, iterations, ns, cycles, perf)) {
+            setFailure(
+                Failure::fromMessage(file, line, "benchmark body must loop while state.KeepRunning()"));
+            return;
+        }
+        if (ns >= min_ns || iterations >= 1000000000) break;
+
+        const double grow = ns > 0 ? min_ns * 1.2 / ns : 10.0;
+        iterations = std::max(iterations + 1, static_cast<std::size_t>(iterations * std::min(std::max(grow, 1.5), 10.0)));
+    }
+
+    std::vector<double> samples;
+    double total_cycles = 0;
+    detail::PerfCounts total_perf;
+    total_perf.available = ~0u;
+
+    for (std::size_t i = 0; i < TestState::getBenchmarkSamples(); i++) {
+        runBenchmarkBatch(f, iterations, ns, cycles, perf);
+        samples.push_back(ns / iterations);
+        total_cycles += cycles / iterations;
+        total_perf.available &= perf.available;
+        for (int c = 0; c < detail::PerfCounterCount; c++)
+            total_perf.values[c] += perf.values[c];
+    }
+
+    BenchmarkResult result = BenchmarkResult::fromSamples(iterations, samples, total_cycles / samples.size());
+    result.perf = total_perf;
+    for (int c = 0; c < detail::PerfCounterCount; c++)
+        result.perf.values[c] /= static_cast<double>(iterations * samples.size());
+    TestState::getCurrentTest()->setBenchmark(result);
+
+    Test* test = TestState::getCurrentTest();
+    if (test->testCase() && (TestState::getCompareBaselines() || TestState::getUpdateBaselines()))
+        checkBaseline(test->testCase()->name() + "." + test->name(), samples, TestState::getBaselineTolerance(), file, line);
+}
+
+} // namespace picotest::framework
+
+/***** property-based testing *****/
+
+// xoshiro256** seeded through splitmix64: fast, and the same sequence everywhere for a given seed
+class Random {
+public:
+    explicit Random(uint64_t seed) {
+        for (int i = 0; i < 4; i++)
+            state_[i] = splitMix(seed);
+    }
+
+    uint64_t next() {
+        const uint64_t result = rotl(state_[1] * 5, 7) * 9;
+        const uint64_t t = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = rotl(state_[3], 45);
+        return result;
+    }
+
+    // uniform in [0, n); 0 stands for 2^64
+    uint64_t below(uint64_t n) {
+        if (n == 0) return next();
+        const uint64_t threshold = (0 - n) % n; // 2^64 mod n: rejecting values under it removes the bias
+        for (;;) {
+            const uint64_t r = next();
+            if (r >= threshold) return r % n;
+        }
+    }
+
+    // uniform in [0, 1)
+    double uniform() {
+        return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    static uint64_t splitMix(uint64_t& x) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t state_[4];
+};
+
+// generators of PROPERTY arguments. a generator is any type with
+//   typedef ... value_type;
+//   value_type generate(Random& random, std::size_t size) const;  // size grows from 1 to 100 over the cases
+//   void shrink(const value_type& value, std::vector<value_type>& smaller) const;  // simpler values, simplest first
+namespace gen {
+
+// integers in [lo, hi], shrinking towards the one closest to 0
+template<typename T>
+class Integer {
+public:
+    typedef T value_type;
+
+    Integer(T lo, T hi) : lo_(lo), hi_(hi), origin_(T() < lo ? lo : (hi < T() ? hi : T())) {}
 
-        if (success())
-            coloredPrint(detail::COLOR_GREEN, "[ PASSED ] ");
-        else
-            coloredPrint(detail::COLOR_RED, "[ FAILED ] ");
+    T generate(Random& random, std::size_t) const {
+        switch (random.below(16)) { // the bounds come up often: off-by-one bugs live there
+        case 0:  return lo_;
+        case 1:  return hi_;
+        case 2:  return origin_;
+        default: return offset(lo_, random.below(distance(lo_, hi_) + 1));
+        }
+    }
 
-        for (Tests::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
-            if (!(*it).success()) (*it).reportFailure(os);
+    void shrink(const T& value, std::vector<T>& smaller) const {
+        const bool below = value < origin_;
+        for (uint64_t step = below ? distance(value, origin_) : distance(origin_, value); step > 0; step /= 2)
+            smaller.push_back(offset(value, below ? step : 0 - step));
+    }
 
-        os << std::endl;
+private:
+    static uint64_t distance(T lo, T hi) {
+        return static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
     }
 
-    bool success() const {
-        if (!executed_) return false;
+    static T offset(T value, uint64_t delta) {
+        return static_cast<T>(static_cast<uint64_t>(value) + delta);
+    }
 
-        if (std::find_if(
-                tests_.begin(), 
-                tests_.end(), 
-                std::not1(std::mem_fun_ref(&Test::success))) == tests_.end())
-            return true;
+    T lo_;
+    T hi_;
+    T origin_;
+};
 
-        return false; // at least one test failed
+// floating point numbers in [lo, hi], shrinking towards the one closest to 0 and towards whole numbers
+template<typename T>
+class Real {
+public:
+    typedef T value_type;
+
+    Real(T lo, T hi) : lo_(lo), hi_(hi), origin_(T() < lo ? lo : (hi < T() ? hi : T())) {}
+
+    T generate(Random& random, std::size_t) const {
+        switch (random.below(16)) {
+        case 0:  return lo_;
+        case 1:  return hi_;
+        case 2:  return origin_;
+        default: {
+            const T u = static_cast<T>(random.uniform());
+            return std::min(hi_, lo_ * (1 - u) + hi_ * u); // not hi_ - lo_, which may overflow
+        }
+        }
     }
 
-    const std::string& name() const {
-        return name_;
+    void shrink(const T& value, std::vector<T>& smaller) const {
+        if (value == origin_ || value != value) return;
+
+        smaller.push_back(origin_);
+        const T whole = std::trunc(value);
+        if (whole != value && lo_ <= whole && whole <= hi_) smaller.push_back(whole);
+        T step = value / 2 - origin_ / 2;
+        for (int i = 0; i < 16 && value - step != value; i++, step /= 2)
+            smaller.push_back(value - step);
     }
 
 private:
-    bool executed_;
-    std::string name_;
-    Tests tests_;
+    T lo_;
+    T hi_;
+    T origin_;
 };
 
-struct Registry {
+class Boolean {
 public:
-    typedef std::vector<TestCase> TestCases;
+    typedef bool value_type;
 
-    static Registry& getInstance() {
-        static Registry instance;
-        return instance;
+    bool generate(Random& random, std::size_t) const {
+        return random.below(2) != 0;
     }
 
-    void add(const std::string& test_case_name, const Test& t) {
-        TestCases::iterator found = find_by_name(test_case_name);
+    void shrink(const bool& value, std::vector<bool>& smaller) const {
+        if (value) smaller.push_back(false);
+    }
+};
+
+// vectors or strings of up to max_size elements (fewer in the early, small cases); shrinking removes
+// elements, in halves down to single ones, then simplifies the remaining ones
+template<typename Container, typename Element>
+class Sequence {
+public:
+    typedef Container value_type;
+
+    Sequence(const Element& element, std::size_t max_size) : element_(element), max_size_(max_size) {}
+
+    Container generate(Random& random, std::size_t size) const {
+        const std::size_t n = static_cast<std::size_t>(random.below(max_size_ * size / 100 + 1));
+        Container c;
+        for (std::size_t i = 0; i < n; i++)
+            c.push_back(element_.generate(random, size));
+        return c;
+    }
+
+    void shrink(const Container& value, std::vector<Container>& smaller) const {
+        for (std::size_t chunk = value.size(); chunk > 0; chunk /= 2) {
+            for (std::size_t begin = 0; begin + chunk <= value.size(); begin += chunk) {
+                smaller.push_back(Container(value.begin(), value.begin() + begin));
+                smaller.back().insert(smaller.back().end(), value.begin() + begin + chunk, value.end());
+            }
+        }
 
-        if (found == tests_.end()) {
-            tests_.push_back(TestCase(test_case_name));
-            found = find_by_name(test_case_name);
+        std::vector<typename Element::value_type> elements;
+        for (std::size_t i = 0; i < value.size(); i++) {
+            elements.clear();
+            element_.shrink(value[i], elements);
+            for (std::size_t j = 0; j < elements.size(); j++) {
+                smaller.push_back(value);
+                smaller.back()[i] = elements[j];
+            }
         }
-        (*found).add(t);
     }
 
-    template<typename Char, typename CharTraits>
-    void testRun(std::basic_ostream<Char, CharTraits>& os) {
-        for (TestCases::iterator it = tests_.begin(); it != tests_.end(); ++it)
-            it->execute(os);
+private:
+    Element element_;
+    std::size_t max_size_;
+};
+
+template<typename T>
+Integer<T> integer(T lo, T hi) {
+    return Integer<T>(lo, hi);
+}
+
+template<typename T>
+Integer<T> integer() {
+    return Integer<T>(std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+}
+
+template<typename T>
+Real<T> real(T lo, T hi) {
+    return Real<T>(lo, hi);
+}
+
+inline Boolean boolean() {
+    return Boolean();
+}
+
+template<typename Element>
+Sequence<std::vector<typename Element::value_type>, Element> vector(const Element& element, std::size_t max_size = 64) {
+    return Sequence<std::vector<typename Element::value_type>, Element>(element, max_size);
+}
+
+// printable ASCII
+inline Sequence<std::string, Integer<char> > string(std::size_t max_size = 64) {
+    return Sequence<std::string, Integer<char> >(Integer<char>(' ', '~'), max_size);
+}
+
+template<typename Element>
+Sequence<std::basic_string<typename Element::value_type>, Element> string(const Element& characters, std::size_t max_size = 64) {
+    return Sequence<std::basic_string<typename Element::value_type>, Element>(characters, max_size);
+}
+
+} // namespace picotest::gen
+
+// base of a PROPERTY: GetArg<I>() is the I-th argument of the case being checked
+template<typename... Args>
+class PropertyTest : public ::testing::Test {
+public:
+    typedef std::tuple<Args...> ArgsType;
+
+    PropertyTest() : args_(current()) {}
+
+    template<std::size_t I = 0>
+    const typename std::tuple_element<I, ArgsType>::type& GetArg() const {
+        return std::get<I>(*args_);
     }
 
-    template<typename Char, typename CharTraits>
-    void report(std::basic_ostream<Char, CharTraits>& os) const {
-        std::size_t failed = numFailed();
+    // the arguments of the cases constructed on this thread
+    static const ArgsType*& current() {
+        static thread_local const ArgsType* args = 0;
+        return args;
+    }
 
-        if (failed) {
-            os << numFailed() << " of " << numTotal() << " tests failed." << std::endl;
+private:
+    const ArgsType* args_;
+};
 
-            for (TestCases::const_iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
-                if (!(*it).success()) (*it).report(os);
-        } else {
-            os << numSuccess() << " tests success." << std::endl;
-        }
+namespace framework {
+
+// while alive, assertion failures on the calling thread are counted here; unless 'record' is set they
+// are not recorded for the test (e.g. while a property looks for a failing case)
+class FailureCapture {
+public:
+    explicit FailureCapture(bool record = false) : failures_(0), record_(record), previous_(TestState::getFailureCapture()) {
+        TestState::setFailureCapture(this);
     }
 
-    bool fail() const {
-        return numTotal() > 0 && numFailed() > 0;
+    ~FailureCapture() {
+        TestState::setFailureCapture(previous_);
     }
 
-    std::size_t numFailed() const {
-        return numTotal() - numSuccess();
+    void count() {
+        failures_++;
     }
 
-    std::size_t numSuccess() const {
-        return std::count_if(tests_.begin(), tests_.end(), std::mem_fun_ref(&TestCase::success));
+    std::size_t failures() const {
+        return failures_;
     }
 
-    std::size_t numTotal() const {
-        return tests_.size();
+    bool record() const {
+        return record_;
     }
 
 private:
-    Registry(){}
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(FailureCapture);
 
-    PICOTEST_DISALLOW_COPY_AND_ASSIGN(Registry);
+    std::size_t failures_;
+    bool record_;
+    FailureCapture* previous_;
+};
 
-    TestCases::iterator find_by_name(const std::string& test_case_name) {
-        for (TestCases::iterator it = tests_.begin(), end = tests_.end(); it != end; ++it)
-            if ((*it).name() == test_case_name) return it;
+// prefixes a fixed description to the failures on the calling thread while alive
+class ScopedFailureContext : public FailureContext {
+public:
+    explicit ScopedFailureContext(const std::string& description) : description_(description) {
+        TestState::setFailureContext(this);
+    }
 
-        return tests_.end();
+    ~ScopedFailureContext() {
+        TestState::setFailureContext(0);
     }
 
-    TestCases tests_;
+    virtual std::string describe() const {
+        return description_;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(ScopedFailureContext);
+
+    std::string description_;
 };
 
-struct Registrar {
-    Registrar (const std::string& test_case_name, const Test& t) {
-        Registry::getInstance().add(test_case_name, t);
-    }
+// a shrinking candidate is checked at most this many times per property
+const std::size_t PROPERTY_MAX_SHRINK_RUNS = 10000;
+
+template<typename... Generators>
+struct PropertyFor {
+    typedef PropertyTest<typename Generators::value_type...> type;
 };
 
+// only named in decltype, by PROPERTY
+template<typename... Generators>
+PropertyFor<Generators...> propertyFor(const Generators&...);
+
+// every case has a generator of its own, so that any one can be regenerated alone, on any thread
+inline uint64_t propertyCaseSeed(uint32_t seed, std::size_t index) {
+    return (static_cast<uint64_t>(seed) << 32) ^ index;
+}
+
+// grows from 1 to 100 over the cases, so that the first ones are small
+inline std::size_t propertyCaseSize(std::size_t index, std::size_t cases) {
+    return 1 + index * 99 / std::max<std::size_t>(cases - 1, 1);
+}
+
+template<typename Args, typename Generators, std::size_t... I>
+Args generatePropertyArgs(const Generators& generators, Random& random, std::size_t size, detail::Indices<I...>) {
+    return Args{ std::get<I>(generators).generate(random, size)... }; // braces: generated from left to right
+}
+
+template<std::size_t I, typename Args, typename Generators>
+void shrinkPropertyArg(const Generators& generators, const Args& args, std::vector<Args>& smaller) {
+    std::vector<typename std::tuple_element<I, Args>::type> values;
+    std::get<I>(generators).shrink(std::get<I>(args), values);
+    for (std::size_t i = 0; i < values.size(); i++) {
+        smaller.push_back(args);
+        std::get<I>(smaller.back()) = values[i];
+    }
+}
+
+// the simpler cases next to args: one argument shrunk, the others unchanged
+template<typename Args, typename Generators, std::size_t... I>
+void shrinkPropertyArgs(const Generators& generators, const Args& args, std::vector<Args>& smaller, detail::Indices<I...>) {
+    const int expand[] = { 0, (shrinkPropertyArg<I>(generators, args, smaller), 0)... };
+    (void)expand;
+}
+
+inline std::string describePropertyArg(const std::string& arg) {
+    return "\"" + arg + "\"";
+}
+
+template<typename T>
+std::string describePropertyArg(const T& arg) {
+    return detail::toString(arg);
+}
+
+// "(1, \"ab\", {1,2})"
+template<typename Args, std::size_t... I>
+std::string describePropertyArgs(const Args& args, detail::Indices<I...>) {
+    std::string description;
+    const int expand[] = { 0, (description.append(I ? ", " : "").append(describePropertyArg(std::get<I>(args))), 0)... };
+    (void)expand;
+    return sizeof...(I) > 1 ? "(" + description + ")" : description;
+}
+
+template<typename Fixture>
+void runPropertyCase(const typename Fixture::ArgsType& args) {
+    Fixture::current() = &args;
+    {
+        Fixture fixture;
+        fixture.execute();
+    }
+    Fixture::current() = 0;
+}
+
+template<typename Fixture>
+bool propertyHolds(const typename Fixture::ArgsType& args) {
+    FailureCapture capture;
+    runPropertyCase<Fixture>(args);
+    return capture.failures() == 0;
+}
+
+// checks the body on TestState::getPropertyCases() generated cases, spread over TestState::getPropertyThreads().
+// the first failing case (by index, so that the threads do not change the outcome) is shrunk as long as a simpler
+// one fails too, then run once more with its failures recorded, prefixed with the arguments and the seed.
+template<typename Fixture, typename... Generators>
+void runProperty(const char* file, int line, const Generators&... generator_list) {
+    typedef typename Fixture::ArgsType Args;
+    typedef typename detail::MakeIndices<sizeof...(Generators)>::type Indices;
+
+    const std::tuple<Generators...> generators(generator_list...);
+    const uint32_t seed = TestState::getRandomSeed() ? TestState::getRandomSeed() : detail::makeRandomSeed();
+    const std::size_t cases = TestState::getPropertyCases();
+    const std::size_t threads = std::min(detail::resolveJobs(TestState::getPropertyThreads()), std::max<std::size_t>(cases, 1));
+    Test* test = TestState::getCurrentTest();
+    std::atomic<std::size_t> next(0), failing(cases);
+
+    auto check = [&] {
+        for (;;) {
+            const std::size_t i = next++;
+            if (i >= failing.load()) return;
+
+            Random random(propertyCaseSeed(seed, i));
+            if (propertyHolds<Fixture>(generatePropertyArgs<Args>(generators, random, propertyCaseSize(i, cases), Indices())))
+                continue;
+            std::size_t first = failing.load();
+            while (i < first && !failing.compare_exchange_weak(first, i)) {}
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 1; t < threads; t++)
+        workers.push_back(std::thread([&] { AdoptTest adopt(test); check(); }));
+    check();
+    for (std::size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    const std::size_t index = failing.load();
+    if (index == cases) return;
+
+    Random random(propertyCaseSeed(seed, index));
+    Args smallest = generatePropertyArgs<Args>(generators, random, propertyCaseSize(index, cases), Indices());
+    std::vector<Args> smaller;
+    std::size_t steps = 0, runs = 0;
+
+    for (bool shrunk = true; shrunk; ) {
+        shrunk = false;
+        smaller.clear();
+        shrinkPropertyArgs(generators, smallest, smaller, Indices());
+        for (std::size_t i = 0; i < smaller.size() && runs < PROPERTY_MAX_SHRINK_RUNS && !shrunk; i++, runs++) {
+            if (propertyHolds<Fixture>(smaller[i])) continue;
+            smallest = smaller[i];
+            steps++;
+            shrunk = true;
+        }
+    }
+
+    std::ostringstream description;
+    description << "falsified by " << describePropertyArgs(smallest, Indices()) << " (case " << index + 1 << " of "
+                << cases << ", seed " << seed << ", shrunk " << steps << " times)";
+
+    std::size_t failures;
+    {
+        ScopedFailureContext context(description.str());
+        FailureCapture capture(true);
+        runPropertyCase<Fixture>(smallest);
+        failures = capture.failures();
+    }
+    if (failures == 0)
+        setFailure(Failure::fromMessage(file, line, "property " + description.str() + ", but held when run again"));
+}
+
 } // namespace picotest::framework
 
-/***** binary operators *****/
+#ifdef PICOTEST_COROUTINES
+/***** coroutine tests *****/
 
-struct LT {
-    template <typename T1, typename T2>
-    bool operator()(const T1& lhs, const T2& rhs) { return lhs < rhs; }
-    static std::string name() { return "<"; }
-};
+template<typename T = void> class Task;
 
-struct GT {
-    template <typename T1, typename T2>
-    bool operator()(const T1& lhs, const T2& rhs) { return lhs > rhs; }
-    static std::string name() { return ">"; }
-};
+namespace detail {
+    template<typename T>
+    struct TaskResult {
+        template<typename U>
+        void return_value(U&& value) {
+            value_.emplace(std::forward<U>(value));
+        }
 
-struct LE {
-    template <typename T1, typename T2>
-    bool operator()(const T1& lhs, const T2& rhs) { return lhs <= rhs; }
-    static std::string name() { return "<="; }
-};
+        T result() {
+            return std::move(*value_);
+        }
 
-struct GE {
-    template <typename T1, typename T2>
-    bool operator()(const T1& lhs, const T2& rhs) { return lhs >= rhs; }
-    static std::string name() { return ">="; }
-};
+        std::optional<T> value_;
+    };
 
-struct EQ {
-    template <typename T1, typename T2>
-    bool operator()(const T1& lhs, const T2& rhs) { return lhs == rhs; }
+    template<>
+    struct TaskResult<void> {
+        void return_void() {}
+        void result() {}
+    };
 
-    // use when comparing against null
-    template <typename T>
-    bool operator()(int lhs, T* const rhs) {
-        return reinterpret_cast<const int*>(lhs) == rhs;
+    // a task starts when it is awaited, and resumes whoever awaited it once it completes
+    template<typename T>
+    struct TaskPromise : TaskResult<T> {
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<TaskPromise> h) noexcept {
+                const std::coroutine_handle<> continuation = h.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        Task<T> get_return_object() {
+            return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return std::suspend_always();
+        }
+
+        FinalAwaiter final_suspend() noexcept {
+            return FinalAwaiter();
+        }
+
+        void unhandled_exception() {
+            std::terminate(); // like an exception escaping a TEST
+        }
+
+        std::coroutine_handle<> continuation;
+    };
+
+    struct SleepAwaiter {
+        bool await_ready() const noexcept {
+            return false; // even a time in the past lets the other bodies run first
+        }
+
+        void await_suspend(std::coroutine_handle<> h) const {
+            framework::EventLoop& loop = framework::EventLoop::getInstance();
+            loop.at(when, h, loop.current());
+        }
+
+        void await_resume() const noexcept {}
+
+        std::chrono::steady_clock::time_point when;
+    };
+
+    struct YieldAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) const {
+            framework::EventLoop& loop = framework::EventLoop::getInstance();
+            loop.post(h, loop.current());
+        }
+
+        void await_resume() const noexcept {}
+    };
+} // namespace picotest::detail
+
+// what a CO_TEST body, and the coroutines it co_awaits, return
+template<typename T>
+class Task {
+public:
+    typedef detail::TaskPromise<T> promise_type;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    Task(Task&& other) noexcept : handle_(other.handle_) {
+        other.handle_ = std::coroutine_handle<promise_type>();
     }
 
-    template <typename T>
-    bool operator()(T* const lhs, int rhs) {
-        return lhs == reinterpret_cast<const int*>(rhs);
+    ~Task() {
+        if (handle_) handle_.destroy();
     }
 
-    static std::string name() { return "=="; }
-};
+    bool await_ready() const noexcept {
+        return false;
+    }
 
-struct NE {
-    template <class T1, class T2>
-    bool operator()(const T1& lhs, const T2& rhs) { return !EQ()(lhs, rhs); }
-    static std::string name() { return "!="; }
+    // symmetric transfer: the task runs without nesting on the stack of the coroutine which awaits it
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    T await_resume() {
+        return handle_.promise().result();
+    }
+
+    // hands the coroutine over, e.g. to the event loop, which destroys it once it has completed
+    std::coroutine_handle<> release() {
+        const std::coroutine_handle<> handle = handle_;
+        handle_ = std::coroutine_handle<promise_type>();
+        return handle;
+    }
+
+private:
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(Task);
+
+    std::coroutine_handle<promise_type> handle_;
 };
 
-struct STREQ {
-    bool operator()(const char* lhs, const char* rhs) { return strcmp(lhs, rhs) == 0; }
-    static std::string name() { return "=="; }
+// the clock of the event loop which runs the CO_TESTs (see TestState::getFakeClock)
+inline std::chrono::steady_clock::time_point now() {
+    return framework::EventLoop::getInstance().now();
+}
+
+// co_await sleepFor(d) lets the other CO_TESTs run meanwhile
+template<typename Rep, typename Period>
+detail::SleepAwaiter sleepFor(std::chrono::duration<Rep, Period> d) {
+    detail::SleepAwaiter awaiter = { now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(d) };
+    return awaiter;
+}
+
+inline detail::SleepAwaiter sleepUntil(std::chrono::steady_clock::time_point when) {
+    detail::SleepAwaiter awaiter = { when };
+    return awaiter;
+}
+
+// co_await yield() lets the CO_TESTs which are ready run first
+inline detail::YieldAwaiter yield() {
+    return detail::YieldAwaiter();
+}
+
+// wakes up the CO_TESTs which co_await wait(), e.g. when data arrives on a fake socket; stays set until reset()
+class Event {
+public:
+    struct Awaiter {
+        bool await_ready() const noexcept {
+            return event->set_;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) const {
+            detail::AllocationTrackingPause pause; // an Event outlives the test which waited first
+            Waiter waiter = { h, framework::EventLoop::getInstance().current() };
+            event->waiters_.push_back(waiter);
+        }
+
+        void await_resume() const noexcept {}
+
+        Event* event;
+    };
+
+    Event() : set_(false) {}
+
+    bool isSet() const {
+        return set_;
+    }
+
+    void set() {
+        set_ = true;
+        framework::EventLoop& loop = framework::EventLoop::getInstance();
+        for (std::size_t i = 0; i < waiters_.size(); i++)
+            loop.post(waiters_[i].handle, waiters_[i].task);
+        waiters_.clear();
+    }
+
+    void reset() {
+        set_ = false;
+    }
+
+    Awaiter wait() {
+        Awaiter awaiter = { this };
+        return awaiter;
+    }
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        framework::CoroutineTask* task;
+    };
+
+    PICOTEST_DISALLOW_COPY_AND_ASSIGN(Event);
+
+    bool set_;
+    std::vector<Waiter> waiters_;
 };
 
-struct STRNE {
-    bool operator()(const char* lhs, const char* rhs) { return strcmp(lhs, rhs) != 0; }
-    static std::string name() { return "!="; }
-};
+namespace framework {
+
+// the body of a CO_TEST: hands the coroutine to the event loop. outside of Registry::runCoroutines
+// (e.g. in a worker process) the loop runs it to completion right away
+inline void startCoroutineTest(Task<> (*body)()) {
+    EventLoop& loop = EventLoop::getInstance();
+    loop.spawn(body().release(), TestState::getCurrentTest(), TestState::getCurrentTestCase());
+    if (!loop.batched()) loop.run([](CoroutineTask&) {});
+}
+
+} // namespace picotest::framework
+#endif // ifdef PICOTEST_COROUTINES
+} // namespace picotest
+
+
+/////////////////////////////////////////////////////////////////
+// entry points of the light header
+
+#if !defined PICOTEST_SEPARATE_COMPILATION || defined PICOTEST_IMPLEMENTATION
+
+namespace picotest {
+namespace detail {
+    PICOTEST_API std::string toString(const void* addr, int size) {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(addr);
+        std::ostringstream os;
+        int maxsize = size > 10 ? 10 : size;
+
+        os << "[";
+        for (int i = 0; i < maxsize; i++, p++)
+            os << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(*p) << ((i == size - 1) ? "" : " ");
+        if (size > maxsize)
+            os << "...";
+        os << "]";
 
-struct STRCASEEQ {
-    bool operator()(const char* lhs, const char* rhs) { 
-        return detail::stricmp(lhs, rhs) == 0; 
+        return os.str();
     }
-    static std::string name() { return "=="; }
-};
 
-struct STRCASENE {
-    bool operator()(const char* lhs, const char* rhs) { 
-        return detail::stricmp(lhs, rhs) != 0; 
+    PICOTEST_API std::ostream* newStringStream() {
+        return new std::ostringstream;
+    }
 
+    PICOTEST_API std::string stringStreamContent(const std::ostream& os) {
+        return static_cast<const std::ostringstream&>(os).str();
     }
-    static std::string name() { return "!="; }
-};
 
-struct FLOATEQ {
-    template<typename T>
-    bool operator()(const T& lhs, const T& rhs) {
-        return detail::Floating::almostEqual(lhs, rhs);
+    PICOTEST_API void deleteStringStream(std::ostream* os) {
+        delete static_cast<std::ostringstream*>(os);
     }
-    static std::string name() { return "=="; }
-};
 
-struct FLOATNE {
-    template<typename T>
-    bool operator()(const T& lhs, const T& rhs) {    
-        return !FLOATEQ()(lhs, rhs);
+    PICOTEST_API int stricmp(const char* c1, const char* c2) {
+#ifdef PICOTEST_WINDOWS
+        return _stricmp(c1, c2);
+#else
+        return strcasecmp(c1, c2);
+#endif
     }
-    static std::string name() { return "!="; }
-};
 
-/***** compare implementation *****/
+} // namespace picotest::detail
 
-template<typename T1, typename T2, typename OP>
-bool compare(const T1& expected, const T2& actual, OP op, 
-             const char* expected_str, const char* actual_str, const char* file, int line) {
-    bool test_success = op(expected, actual);
+namespace framework {
 
-    if (!test_success) {
-        framework::TestState::getCurrentTest()->setFailure(
-            framework::Failure(file, line,
-            detail::makeExpressionStr(expected_str, actual_str, op),
-            detail::makeExpressionStr(expected, actual, op)));        
+// an assertion failed on the calling thread (see Test::countFailure)
+PICOTEST_API bool countFailure(const char* file, int line) {
+    if (FailureCapture* capture = TestState::getFailureCapture()) {
+        capture->count();
+        if (!capture->record()) return false;
+    }
+
+    if (TestState::onTestThread()) return TestState::getCurrentTest()->countFailure(file, line);
+
+    detail::AllocationTrackingPause pause;
+    for (;;) {
+        ThreadFailures& buffer = threadFailures();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.merged.load(std::memory_order_relaxed)) continue; // see recordFailure
+        return buffer.log.count(file, line, TestState::getMaxFailures());
     }
-    return test_success;
 }
 
-template<typename T1, typename T2, typename T3>
-bool compare_near(const T1& expected, const T2& actual, const T3& abs_error, 
-             const char* expected_str, const char* actual_str, const char* file, int line) {
-    bool test_success = std::abs(expected - actual) <= abs_error;
+PICOTEST_API void addFailure(const char* file, int line, const std::string& message) {
+    addFailure(Failure::fromMessage(file, line, message));
+}
 
-    if (!test_success) {
-        framework::TestState::getCurrentTest()->setFailure(
+} // namespace picotest::framework
+
+PICOTEST_API bool compare_mem(const void* expected, const void* actual, std::size_t size,
+                              const char* expected_str, const char* actual_str, const char* file, int line) {
+    const unsigned char* e = static_cast<const unsigned char*>(expected);
+    const unsigned char* a = static_cast<const unsigned char*>(actual);
+    const std::size_t first = e == a ? size : detail::findFirstDifference(e, a, 0, size);
+
+    if (first != size) {
+        if (framework::countFailure(file, line)) framework::addFailure(
             framework::Failure(file, line,
-            detail::makeExpressionStr(expected_str, actual_str, picotest::FLOATEQ()),
-            detail::makeExpressionStr(expected, actual, picotest::FLOATEQ())));        
+            std::string(expected_str) + "[0.." + detail::toString(size) + ") == " + actual_str + "[0.." + detail::toString(size) + ")",
+            detail::describeMemMismatch(e, a, size, first)));
     }
-    return test_success;
+    return first == size;
 }
 
-inline bool evaluate(bool expected, bool actual, const char* expression, const char* file, int line) {
-    bool test_success = expected == actual;
+// the golden file is mapped and compared chunk by chunk, never read whole
+PICOTEST_API bool compare_golden(const detail::ByteView& actual, const std::string& path,
+                                 const char* actual_str, const char* file, int line) {
+    const unsigned char* data = static_cast<const unsigned char*>(actual.data);
+    const std::string expression = std::string(actual_str) + " matches golden file '" + path + "'";
+
+    if (framework::TestState::getUpdateGoldens()) {
+        {
+            detail::GoldenFile golden(path);
+            if (golden.exists() && golden.readable() && golden.size() == actual.size &&
+                golden.firstDifference(data, actual.size) == actual.size)
+                return true; // left alone, with its timestamp
+        }
+        if (detail::writeFileAtomically(path, data, actual.size)) return true;
+        if (framework::countFailure(file, line))
+            framework::addFailure(framework::Failure(file, line, expression, std::string("cannot write the golden file")));
+        return false;
+    }
 
-    if (!test_success) {
-        framework::TestState::getCurrentTest()->setFailure(
-            framework::Failure(file, line, expression, expected));    
+    detail::GoldenFile golden(path);
+    if (!golden.exists()) {
+        if (framework::countFailure(file, line))
+            framework::addFailure(framework::Failure(file, line, expression, std::string("no golden file; record it with --update_goldens")));
+        return false;
+    }
+    if (!golden.readable()) {
+        if (framework::countFailure(file, line))
+            framework::addFailure(framework::Failure(file, line, expression, std::string("cannot read the golden file")));
+        return false;
     }
 
-    return test_success;
+    const std::size_t first = golden.firstDifference(data, actual.size);
+    if (first == actual.size && first == golden.size()) return true;
+
+    if (framework::countFailure(file, line))
+        framework::addFailure(framework::Failure(file, line, expression, detail::describeGoldenMismatch(golden, data, actual.size, first)));
+    return false;
 }
 
 } // namespace picotest
 
-// using namespace testing for compatibility with google test
 namespace testing {
 
-class Test {
-public:
-    Test() {}
-    virtual ~Test() {}
-    void execute() {
-        SetUp();
-        test_method(); // template-method
-        TearDown();
-    }
-protected:
-    virtual void SetUp() {}
-    virtual void TearDown() {}
-    virtual void test_method() = 0;
-};
+PICOTEST_API Environment* AddGlobalTestEnvironment(Environment* env) {
+    return picotest::framework::Environments::getInstance().append(env);
+}
 
 } // namespace testing
 
+PICOTEST_API int RUN_ALL_TESTS() {
+    picotest::detail::BufferedOStream out(std::cout);
+
+    picotest::framework::Registry::getInstance().testRun(out);
+    picotest::framework::Registry::getInstance().report(out); 
+    picotest::framework::Baselines::getInstance().compact();
+    out.drain();
+    return picotest::framework::Registry::getInstance().fail() ? 1 : 0;
+}
+
+// recognized flags:
+//   --picotest_jobs=N   run tests on N threads (0 = one per hardware thread)
+//   --picotest_fork     run tests in N forked worker processes instead, isolating crashes (POSIX only)
+//   --picotest_benchmark_samples=N       timed samples per BENCHMARK
+//   --picotest_benchmark_min_time_ms=T   minimum duration of one sample
+//   --picotest_stress_pin_threads        bind each STRESS_TEST thread to its own CPU (Linux only)
+//   --picotest_property_cases=N          random cases tried per PROPERTY (default 1000)
+//   --picotest_property_threads=N        threads checking them (default 1, 0 = one per hardware thread)
+//   --picotest_fake_clock                CO_TEST timers fire at once, in order, instead of after a real wait
+//   --picotest_slowest=N          print the N slowest tests
+//   --picotest_print_time         print the wall-clock and CPU time of each testcase
+//   --picotest_time_budget_ms=T   fail tests which take longer than T milliseconds
+//   --picotest_timeout_ms=T       consider tests hung after T milliseconds: abort the run (or kill the worker) with a backtrace
+//   --picotest_shuffle            run testcases (and the tests within each) in random order; --shuffle also works
+//   --picotest_random_seed=S      seed for --shuffle (default: picked and printed); --random_seed also works
+//   --picotest_repeat=N           run the tests N times and report the failure rate of each; --repeat also works
+//   --picotest_repeat_until_fail  repeat (at most --repeat times) in parallel processes until a run fails
+//   --picotest_max_failures=N     failure messages recorded per test, later ones are only counted (default 100, 0 = all)
+//   --picotest_leak_check         fail tests which do not free what they allocated (needs PICOTEST_TRACK_ALLOCATIONS)
+//   --picotest_perf_counters      record and print hardware performance counters (Linux only)
+//   --picotest_baselines[=PATH]   compare benchmarks against the baseline file (default picotest.baseline)
+//   --picotest_baseline_tolerance=F  slowdown allowed to benchmarks against their baseline (default 0.05)
+//   --picotest_update_baselines   record baselines instead of comparing; --update_baselines also works
+//   --picotest_update_goldens     rewrite the golden files of EXPECT_MATCHES_GOLDEN; --update_goldens also works
+//   --picotest_output=xml:PATH    write a JUnit XML report (json:PATH for newline-delimited JSON); may be repeated
+//   --picotest_filter=PATTERNS    run only matching tests, e.g. "Suite.*-Suite.Slow*"
+//   --picotest_list_tests         print the (filtered) tests instead of running them; --list_tests also works
+PICOTEST_API int RUN_ALL_TESTS(int argc, char** argv) {
+    std::string value;
+    bool list_tests = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (picotest::detail::parseFlag(argv[i], "picotest_jobs", value))
+            picotest::framework::TestState::setJobs(static_cast<std::size_t>(atoi(value.c_str())));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_fork", value))
+            picotest::framework::TestState::setProcessIsolation(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_benchmark_samples", value))
+            picotest::framework::TestState::setBenchmarkSamples(static_cast<std::size_t>(atoi(value.c_str())));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_stress_pin_threads", value))
+            picotest::framework::TestState::setStressPinThreads(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_property_cases", value))
+            picotest::framework::TestState::setPropertyCases(static_cast<std::size_t>(atoi(value.c_str())));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_property_threads", value))
+            picotest::framework::TestState::setPropertyThreads(static_cast<std::size_t>(atoi(value.c_str())));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_fake_clock", value))
+            picotest::framework::TestState::setFakeClock(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_benchmark_min_time_ms", value))
+            picotest::framework::TestState::setBenchmarkMinTimeMs(atof(value.c_str()));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_slowest", value))
+            picotest::framework::TestState::setSlowestTests(static_cast<std::size_t>(atoi(value.c_str())));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_print_time", value))
+            picotest::framework::TestState::setPrintTime(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_time_budget_ms", value))
+            picotest::framework::TestState::setTimeBudgetMs(atof(value.c_str()));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_timeout_ms", value))
+            picotest::framework::TestState::setTimeoutMs(atof(value.c_str()));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_shuffle", value) ||
+                 picotest::detail::parseFlag(argv[i], "shuffle", value))
+            picotest::framework::TestState::setShuffle(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_random_seed", value) ||
+                 picotest::detail::parseFlag(argv[i], "random_seed", value))
+            picotest::framework::TestState::setRandomSeed(static_cast<uint32_t>(strtoul(value.c_str(), 0, 10)));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_repeat", value) ||
+                 picotest::detail::parseFlag(argv[i], "repeat", value))
+            picotest::framework::TestState::setRepeat(static_cast<std::size_t>(atoi(value.c_str())));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_repeat_until_fail", value) ||
+                 picotest::detail::parseFlag(argv[i], "repeat_until_fail", value))
+            picotest::framework::TestState::setRepeatUntilFail(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_max_failures", value))
+            picotest::framework::TestState::setMaxFailures(static_cast<std::size_t>(atoi(value.c_str())));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_leak_check", value))
+            picotest::framework::TestState::setLeakCheck(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_perf_counters", value))
+            picotest::framework::TestState::setPerfCounters(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_baselines", value)) {
+            if (!value.empty()) picotest::framework::TestState::setBaselinePath(value);
+            picotest::framework::TestState::setCompareBaselines(true);
+        }
+        else if (picotest::detail::parseFlag(argv[i], "picotest_baseline_tolerance", value))
+            picotest::framework::TestState::setBaselineTolerance(atof(value.c_str()));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_update_baselines", value) ||
+                 picotest::detail::parseFlag(argv[i], "update_baselines", value))
+            picotest::framework::TestState::setUpdateBaselines(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_update_goldens", value) ||
+                 picotest::detail::parseFlag(argv[i], "update_goldens", value))
+            picotest::framework::TestState::setUpdateGoldens(picotest::detail::parseBool(value));
+        else if (picotest::detail::parseFlag(argv[i], "picotest_output", value))
+            picotest::framework::addReporter(value);
+        else if (picotest::detail::parseFlag(argv[i], "picotest_filter", value))
+            picotest::framework::TestState::setFilter(value);
+        else if (picotest::detail::parseFlag(argv[i], "picotest_list_tests", value) ||
+                 picotest::detail::parseFlag(argv[i], "list_tests", value))
+            list_tests = picotest::detail::parseBool(value);
+    }
+
+    if (list_tests) {
+        picotest::detail::BufferedOStream out(std::cout);
+        picotest::framework::Registry::getInstance().listTests(out);
+        return 0;
+    }
+    return RUN_ALL_TESTS();
+}
+
+#endif // entry points
+
+#endif // ifndef PICOTEST_LIGHT
+
 
 /////////////////////////////////////////////////////////////////
 // test with auto-registration
@@ -655,21 +7327,39 @@ protected:
 #define PICOTEST_TEST_CASE_INVOKER(test_case_name, test_name) \
 PICOTEST_JOIN(PICOTEST_IDENITY(test_case_name, test_name), _invoker)
 
-#define PICOTEST_TEST_CASE_REGISTRAR(test_case_name, test_name) \
-static picotest::framework::Registrar PICOTEST_JOIN(PICOTEST_IDENITY(test_case_name, test_name), _registrar)
+#define PICOTEST_TEST_CASE_INFO(test_case_name, test_name) \
+PICOTEST_JOIN(PICOTEST_IDENITY(test_case_name, test_name), _info)
+
+#define PICOTEST_TEST_CASE_REGISTRAR(test_case_name, test_name, flags, set_up, tear_down, timeout_ms) \
+static picotest::framework::TestInfo PICOTEST_TEST_CASE_INFO(test_case_name, test_name) = { \
+    PICOTEST_TEST_ARGS(test_case_name, test_name), flags, set_up, tear_down, timeout_ms, 0 }; \
+static picotest::framework::TestLink PICOTEST_JOIN(PICOTEST_IDENITY(test_case_name, test_name), _registrar)( \
+    PICOTEST_TEST_CASE_INFO(test_case_name, test_name))
 
 #define PICOTEST_MAKE_TEST(test_case_name, test_name) \
 picotest::framework::Test(PICOTEST_STR(test_name), PICOTEST_TEST_CASE_INVOKER(test_case_name, test_name))
 
+#define PICOTEST_TEST_ARGS(test_case_name, test_name) \
+PICOTEST_STR(test_case_name), PICOTEST_STR(test_name), PICOTEST_TEST_CASE_INVOKER(test_case_name, test_name)
+
 #define TEST(test_case_name, test_name) \
-PICOTEST_TEST_CASE_AUTO_REGISTER(test_case_name, test_name, ::testing::Test)
+PICOTEST_TEST_CASE_AUTO_REGISTER(test_case_name, test_name, ::testing::Test, 0)
 
 
 #define TEST_F(test_fixture, test_name) \
-PICOTEST_TEST_CASE_AUTO_REGISTER(test_fixture, test_name, test_fixture)
+PICOTEST_TEST_CASE_AUTO_REGISTER(test_fixture, test_name, test_fixture, 0)
+
+
+// TEST_TIMEOUT(Queue, Drain, 500) is a TEST which is considered hung after 500ms, whatever --picotest_timeout_ms says
+#define TEST_TIMEOUT(test_case_name, test_name, timeout_ms) \
+PICOTEST_TEST_CASE_AUTO_REGISTER(test_case_name, test_name, ::testing::Test, timeout_ms)
+
 
+#define TEST_F_TIMEOUT(test_fixture, test_name, timeout_ms) \
+PICOTEST_TEST_CASE_AUTO_REGISTER(test_fixture, test_name, test_fixture, timeout_ms)
 
-#define PICOTEST_TEST_CASE_AUTO_REGISTER(test_case_name, test_name, base_t) \
+
+#define PICOTEST_TEST_CASE_AUTO_REGISTER(test_case_name, test_name, base_t, timeout_ms) \
 struct PICOTEST_IDENITY(test_case_name, test_name) : public base_t {        \
     void test_method();                                                     \
 };                                                                          \
@@ -679,13 +7369,186 @@ void PICOTEST_TEST_CASE_INVOKER(test_case_name, test_name)() {              \
     t.execute();                                                            \
 }                                                                           \
                                                                             \
-PICOTEST_TEST_CASE_REGISTRAR(test_case_name, test_name)(                    \
-    PICOTEST_STR(test_case_name),                                           \
-    PICOTEST_MAKE_TEST(test_case_name, test_name));                         \
+PICOTEST_TEST_CASE_REGISTRAR(test_case_name, test_name, 0,                  \
+    &picotest::framework::FixtureHooks<base_t>::setUpTestCase,              \
+    &picotest::framework::FixtureHooks<base_t>::tearDownTestCase, timeout_ms); \
+                                                                            \
+void PICOTEST_IDENITY(test_case_name, test_name)::test_method()
+
+
+/////////////////////////////////////////////////////////////////
+// value-parameterized test with auto-registration
+
+// TEST_P(Codec, RoundTrip) { ... GetParam() ... } runs for every parameter of every INSTANTIATE_TEST_CASE_P of
+// the fixture Codec (derived from ::testing::TestWithParam<T>)
+#define TEST_P(test_fixture, test_name) \
+PICOTEST_PARAM_TEST_AUTO_REGISTER(test_fixture, test_name)
+
+
+// INSTANTIATE_TEST_CASE_P(Small, Codec, Range(0, 100)) adds the tests Small/Codec.RoundTrip/0 .. /99
+#define INSTANTIATE_TEST_CASE_P(prefix, test_fixture, ...)                   \
+static picotest::framework::ParamInstantiation<test_fixture, decltype(__VA_ARGS__)> \
+    PICOTEST_JOIN(PICOTEST_IDENITY(prefix, test_fixture), _instantiation)(  \
+        PICOTEST_STR(prefix), PICOTEST_STR(test_fixture), __VA_ARGS__)
+
+
+#define PICOTEST_PARAM_TEST_AUTO_REGISTER(test_fixture, test_name)          \
+struct PICOTEST_IDENITY(test_fixture, test_name) : public test_fixture {    \
+    void test_method();                                                     \
+};                                                                          \
+                                                                            \
+void PICOTEST_TEST_CASE_INVOKER(test_fixture, test_name)() {                \
+    PICOTEST_IDENITY(test_fixture, test_name) t;                            \
+    t.execute();                                                            \
+}                                                                           \
+                                                                            \
+static picotest::framework::ParamTestInfo PICOTEST_TEST_CASE_INFO(test_fixture, test_name) = { \
+    PICOTEST_STR(test_name), PICOTEST_TEST_CASE_INVOKER(test_fixture, test_name), 0 }; \
+static picotest::framework::ParamTestLink PICOTEST_JOIN(PICOTEST_IDENITY(test_fixture, test_name), _registrar)( \
+    picotest::framework::paramTests<test_fixture>(), PICOTEST_TEST_CASE_INFO(test_fixture, test_name)); \
+                                                                            \
+void PICOTEST_IDENITY(test_fixture, test_name)::test_method()
+
+
+/////////////////////////////////////////////////////////////////
+// property with auto-registration
+
+// PROPERTY(Sort, Idempotent, picotest::gen::vector(picotest::gen::integer(-100, 100))) { ... GetArg() ... }
+// checks its body on --picotest_property_cases random arguments; GetArg<1>() is the one of the second generator
+#define PROPERTY(test_case_name, test_name, ...) \
+PICOTEST_PROPERTY_AUTO_REGISTER(test_case_name, test_name, __VA_ARGS__)
+
+
+#define PICOTEST_PROPERTY_AUTO_REGISTER(test_case_name, test_name, ...)    \
+struct PICOTEST_IDENITY(test_case_name, test_name)                          \
+    : public decltype(::picotest::framework::propertyFor(__VA_ARGS__))::type { \
+    void test_method();                                                     \
+};                                                                          \
+                                                                            \
+void PICOTEST_TEST_CASE_INVOKER(test_case_name, test_name)() {              \
+    picotest::framework::runProperty<PICOTEST_IDENITY(test_case_name, test_name)>( \
+        __FILE__, __LINE__, __VA_ARGS__);                                   \
+}                                                                           \
+                                                                            \
+PICOTEST_TEST_CASE_REGISTRAR(test_case_name, test_name, 0, 0, 0, 0);        \
                                                                             \
 void PICOTEST_IDENITY(test_case_name, test_name)::test_method()
 
 
+#ifdef PICOTEST_COROUTINES
+/////////////////////////////////////////////////////////////////
+// coroutine test with auto-registration
+
+// CO_TEST(Socket, Echo) { ... co_await picotest::sleepFor(std::chrono::milliseconds(10)); ... } is a coroutine
+// returning picotest::Task<>; the CO_TESTs of a run are interleaved on one event loop. CO_ASSERT_XX leave it
+// with co_return, since ASSERT_XX cannot.
+#define CO_TEST(test_case_name, test_name) \
+PICOTEST_CO_TEST_AUTO_REGISTER(test_case_name, test_name)
+
+
+#define PICOTEST_CO_TEST_AUTO_REGISTER(test_case_name, test_name)          \
+::picotest::Task<> PICOTEST_IDENITY(test_case_name, test_name)();           \
+                                                                            \
+void PICOTEST_TEST_CASE_INVOKER(test_case_name, test_name)() {              \
+    picotest::framework::startCoroutineTest(PICOTEST_IDENITY(test_case_name, test_name)); \
+}                                                                           \
+                                                                            \
+PICOTEST_TEST_CASE_REGISTRAR(test_case_name, test_name,                     \
+    picotest::framework::TestFlagCoroutine, 0, 0, 0);                       \
+                                                                            \
+::picotest::Task<> PICOTEST_IDENITY(test_case_name, test_name)()
+
+#define CO_ASSERT_BOOL(expected, expression) \
+do {\
+    if (!EXPECT_BOOL(expected, expression)){\
+        co_return;\
+    }\
+} while(0)
+
+#define CO_ASSERT_BINARY(lhs, rhs, OP) \
+do {\
+    if (!EXPECT_BINARY(lhs, rhs, OP)){\
+        co_return;\
+    }\
+} while(0)
+
+#define CO_ASSERT_TRUE(cond) CO_ASSERT_BOOL(true, cond)
+#define CO_ASSERT_FALSE(cond) CO_ASSERT_BOOL(false, cond)
+#define CO_ASSERT_EQ(expected, actual) CO_ASSERT_BINARY(expected, actual, picotest::EQ)
+#define CO_ASSERT_NE(expected, actual) CO_ASSERT_BINARY(expected, actual, picotest::NE)
+#define CO_ASSERT_LT(expected, actual) CO_ASSERT_BINARY(expected, actual, picotest::LT)
+#define CO_ASSERT_GT(expected, actual) CO_ASSERT_BINARY(expected, actual, picotest::GT)
+#define CO_ASSERT_LE(expected, actual) CO_ASSERT_BINARY(expected, actual, picotest::LE)
+#define CO_ASSERT_GE(expected, actual) CO_ASSERT_BINARY(expected, actual, picotest::GE)
+#define CO_ASSERT_STREQ(expected_str, actual_str) CO_ASSERT_BINARY(expected_str, actual_str, picotest::STREQ)
+#define CO_ASSERT_STRNE(expected_str, actual_str) CO_ASSERT_BINARY(expected_str, actual_str, picotest::STRNE)
+#endif // ifdef PICOTEST_COROUTINES
+
+
+/////////////////////////////////////////////////////////////////
+// benchmark with auto-registration
+
+#define BENCHMARK(group, name) \
+PICOTEST_BENCHMARK_AUTO_REGISTER(group, name)
+
+
+#define PICOTEST_BENCHMARK_AUTO_REGISTER(group, name)                       \
+void PICOTEST_IDENITY(group, name)(::benchmark::State& state);              \
+                                                                            \
+void PICOTEST_TEST_CASE_INVOKER(group, name)() {                            \
+    picotest::framework::runBenchmark(                                      \
+        PICOTEST_IDENITY(group, name), __FILE__, __LINE__);                 \
+}                                                                           \
+                                                                            \
+PICOTEST_TEST_CASE_REGISTRAR(group, name,                                   \
+    picotest::framework::TestFlagSerial, 0, 0, 0);                          \
+                                                                            \
+void PICOTEST_IDENITY(group, name)(::benchmark::State& state)
+
+
+/////////////////////////////////////////////////////////////////
+// stress test with auto-registration
+
+// STRESS_TEST(Queue, PushPop, 8, 100000) runs its body on 8 threads, which KeepRunning() for 100000 iterations each
+#define STRESS_TEST(test_case_name, test_name, threads, iterations) \
+PICOTEST_STRESS_AUTO_REGISTER(test_case_name, test_name, ::testing::Test, threads, iterations, 0)
+
+
+// STRESS_TEST_FOR(Queue, PushPop, 8, 500) keeps them running for 500ms instead
+#define STRESS_TEST_FOR(test_case_name, test_name, threads, duration_ms) \
+PICOTEST_STRESS_AUTO_REGISTER(test_case_name, test_name, ::testing::Test, threads, 0, duration_ms)
+
+
+// the threads share one fixture, set up before they start and torn down after they finish
+#define STRESS_TEST_F(test_fixture, test_name, threads, iterations) \
+PICOTEST_STRESS_AUTO_REGISTER(test_fixture, test_name, test_fixture, threads, iterations, 0)
+
+
+#define STRESS_TEST_F_FOR(test_fixture, test_name, threads, duration_ms) \
+PICOTEST_STRESS_AUTO_REGISTER(test_fixture, test_name, test_fixture, threads, 0, duration_ms)
+
+
+#define PICOTEST_STRESS_AUTO_REGISTER(test_case_name, test_name, base_t, threads, iterations, duration_ms) \
+struct PICOTEST_IDENITY(test_case_name, test_name) : public base_t {        \
+    void test_method() {                                                    \
+        picotest::framework::runStress(*this, threads, iterations, duration_ms); \
+    }                                                                       \
+    void stress_method(::picotest::StressState& state);                     \
+};                                                                          \
+                                                                            \
+void PICOTEST_TEST_CASE_INVOKER(test_case_name, test_name)() {              \
+    PICOTEST_IDENITY(test_case_name, test_name) t;                          \
+    t.execute();                                                            \
+}                                                                           \
+                                                                            \
+PICOTEST_TEST_CASE_REGISTRAR(test_case_name, test_name,                     \
+    picotest::framework::TestFlagSerial,                                    \
+    &picotest::framework::FixtureHooks<base_t>::setUpTestCase,              \
+    &picotest::framework::FixtureHooks<base_t>::tearDownTestCase, 0);       \
+                                                                            \
+void PICOTEST_IDENITY(test_case_name, test_name)::stress_method(::picotest::StressState& state)
+
+
 /////////////////////////////////////////////////////////////////
 // EXPECT_XX
 
@@ -695,6 +7558,8 @@ void PICOTEST_IDENITY(test_case_name, test_name)::test_method()
     picotest::compare(lhs, rhs, OP(), #lhs, #rhs, __FILE__, __LINE__)
 #define EXPECT_BINARY_NEAR(lhs, rhs, abs_error) \
     picotest::compare_near(lhs, rhs, abs_error, #lhs, #rhs, __FILE__, __LINE__)
+#define EXPECT_ARRAY(expected, actual, count, op) \
+    picotest::compare_array(expected, actual, count, op, #expected, #actual, __FILE__, __LINE__)
 
 #define EXPECT_TRUE(cond) EXPECT_BOOL(true, cond)
 #define EXPECT_FALSE(cond) EXPECT_BOOL(false, cond)
@@ -713,6 +7578,39 @@ void PICOTEST_IDENITY(test_case_name, test_name)::test_method()
 #define EXPECT_FLOAT_NE(expected, actual)  EXPECT_BINARY(expected, actual, picotest::FLOATNE)
 #define EXPECT_DOUBLE_NE(expected, actual) EXPECT_BINARY(expected, actual, picotest::FLOATNE)
 #define EXPECT_NEAR(expected, actual, abs_error) EXPECT_BINARY_NEAR(expected, actual, abs_error)
+#define EXPECT_MEM_EQ(expected, actual, size) \
+    picotest::compare_mem(expected, actual, size, #expected, #actual, __FILE__, __LINE__)
+// EXPECT_MATCHES_GOLDEN(output, "golden/report.txt") compares a string, vector, ... with a file; --update_goldens rewrites it
+#define EXPECT_MATCHES_GOLDEN(actual, path) \
+    picotest::compare_golden(picotest::detail::byteView(actual), path, #actual, __FILE__, __LINE__)
+// EXPECT_PERCENTILE_LE(latencies, 99.9, std::chrono::microseconds(200)) checks a LatencyHistogram;
+// the limit may also be a number of ns
+#define EXPECT_PERCENTILE_LE(hist, percentile, limit) \
+    picotest::compare_percentile(hist, percentile, limit, #hist, #limit, __FILE__, __LINE__)
+
+// EXPECT_NO_ALLOC { hot_path(); } fails if the block allocates on the calling thread
+#define EXPECT_MAX_ALLOCS(max_allocs) \
+    for (picotest::framework::AllocationScope picotest_allocation_scope(max_allocs, __FILE__, __LINE__); \
+         picotest_allocation_scope.once(); )
+#define EXPECT_NO_ALLOC EXPECT_MAX_ALLOCS(0)
+
+// EXPECT_PERF_COUNTER_LT(BranchMisses, 1000) { lookup(); } checks a hardware counter over the block (Linux only).
+// counters: Cycles, Instructions, BranchMisses, L1dMisses, LlcMisses, PageFaults, ContextSwitches
+#define EXPECT_PERF_COUNTER_LT(counter, limit) \
+    for (picotest::framework::PerfCounterScope picotest_perf_scope(PICOTEST_JOIN(picotest::detail::Perf, counter), limit, __FILE__, __LINE__); \
+         picotest_perf_scope.once(); )
+#define EXPECT_CACHE_MISSES_LT(limit) EXPECT_PERF_COUNTER_LT(LlcMisses, limit)
+
+// EXPECT_NOT_SLOWER_THAN_BASELINE("parse/1MB", 0.1) { parse(input); } times the block once per benchmark
+// sample and fails if it is significantly slower than the recorded baseline plus 10%
+#define EXPECT_NOT_SLOWER_THAN_BASELINE(key, tolerance) \
+    for (picotest::framework::BaselineScope picotest_baseline_scope(key, tolerance, __FILE__, __LINE__); \
+         picotest_baseline_scope.next(); )
+#define EXPECT_ARRAY_EQ(expected, actual, count) EXPECT_ARRAY(expected, actual, count, picotest::ARRAY_EQ())
+#define EXPECT_ARRAY_FLOAT_EQ(expected, actual, count)  EXPECT_ARRAY(expected, actual, count, picotest::ARRAY_FLOATEQ())
+#define EXPECT_ARRAY_DOUBLE_EQ(expected, actual, count) EXPECT_ARRAY(expected, actual, count, picotest::ARRAY_FLOATEQ())
+#define EXPECT_ARRAY_NEAR(expected, actual, count, abs_error) \
+    EXPECT_ARRAY(expected, actual, count, picotest::ARRAY_NEAR(abs_error))
 
 /////////////////////////////////////////////////////////////////
 // ASSERT_XX
@@ -731,6 +7629,34 @@ do {\
     }\
 } while(0)
 
+#define ASSERT_ARRAY(expected, actual, count, op) \
+do {\
+    if (!EXPECT_ARRAY(expected, actual, count, op)){\
+        return;\
+    }\
+} while(0)
+
+#define ASSERT_MEM_EQ(expected, actual, size) \
+do {\
+    if (!EXPECT_MEM_EQ(expected, actual, size)){\
+        return;\
+    }\
+} while(0)
+
+#define ASSERT_MATCHES_GOLDEN(actual, path) \
+do {\
+    if (!EXPECT_MATCHES_GOLDEN(actual, path)){\
+        return;\
+    }\
+} while(0)
+
+#define ASSERT_PERCENTILE_LE(hist, percentile, limit) \
+do {\
+    if (!EXPECT_PERCENTILE_LE(hist, percentile, limit)){\
+        return;\
+    }\
+} while(0)
+
 #define ASSERT_TRUE(cond) ASSERT_BOOL(true, cond)
 #define ASSERT_FALSE(cond) ASSERT_BOOL(false, cond)
 #define ASSERT_EQ(expected, actual) ASSERT_BINARY(expected, actual, picotest::EQ)
@@ -747,13 +7673,172 @@ do {\
 #define ASSERT_DOUBLE_EQ(expected, actual) ASSERT_BINARY(expected, actual, picotest::FLOATEQ)
 #define ASSERT_FLOAT_NE(expected, actual)  ASSERT_BINARY(expected, actual, picotest::FLOATNE)
 #define ASSERT_DOUBLE_NE(expected, actual) ASSERT_BINARY(expected, actual, picotest::FLOATNE)
+#define ASSERT_ARRAY_EQ(expected, actual, count) ASSERT_ARRAY(expected, actual, count, picotest::ARRAY_EQ())
+#define ASSERT_ARRAY_FLOAT_EQ(expected, actual, count)  ASSERT_ARRAY(expected, actual, count, picotest::ARRAY_FLOATEQ())
+#define ASSERT_ARRAY_DOUBLE_EQ(expected, actual, count) ASSERT_ARRAY(expected, actual, count, picotest::ARRAY_FLOATEQ())
+#define ASSERT_ARRAY_NEAR(expected, actual, count, abs_error) \
+    ASSERT_ARRAY(expected, actual, count, picotest::ARRAY_NEAR(abs_error))
+
 
 /////////////////////////////////////////////////////////////////
-// RUNNING ALL TESTS
+// macros of the full header
+//
+// a light translation unit (see PICOTEST_SEPARATE_COMPILATION) has none of the macros below. using one stops the
+// build with a message naming it and PICOTEST_FULL_HEADER, instead of errors about missing declarations.
+// TEST/TEST_F/TEST_TIMEOUT/TEST_P, the other EXPECT_/ASSERT_ macros, EXPECT_MEM_EQ and EXPECT_MATCHES_GOLDEN
+// work in light translation units too.
+
+#ifdef PICOTEST_LIGHT
+#define PICOTEST_NEEDS_FULL_HEADER(macro) \
+    static_assert(false, #macro " needs the full picotest header: define PICOTEST_FULL_HEADER before including picotest.h");
+
+#undef PROPERTY
+#define PROPERTY(...) PICOTEST_NEEDS_FULL_HEADER(PROPERTY)
+#undef CO_TEST
+#define CO_TEST(...) PICOTEST_NEEDS_FULL_HEADER(CO_TEST)
+#undef BENCHMARK
+#define BENCHMARK(...) PICOTEST_NEEDS_FULL_HEADER(BENCHMARK)
+#undef STRESS_TEST
+#define STRESS_TEST(...) PICOTEST_NEEDS_FULL_HEADER(STRESS_TEST)
+#undef STRESS_TEST_FOR
+#define STRESS_TEST_FOR(...) PICOTEST_NEEDS_FULL_HEADER(STRESS_TEST_FOR)
+#undef STRESS_TEST_F
+#define STRESS_TEST_F(...) PICOTEST_NEEDS_FULL_HEADER(STRESS_TEST_F)
+#undef STRESS_TEST_F_FOR
+#define STRESS_TEST_F_FOR(...) PICOTEST_NEEDS_FULL_HEADER(STRESS_TEST_F_FOR)
+#undef EXPECT_ARRAY_EQ
+#define EXPECT_ARRAY_EQ(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_ARRAY_EQ)
+#undef EXPECT_ARRAY_FLOAT_EQ
+#define EXPECT_ARRAY_FLOAT_EQ(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_ARRAY_FLOAT_EQ)
+#undef EXPECT_ARRAY_DOUBLE_EQ
+#define EXPECT_ARRAY_DOUBLE_EQ(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_ARRAY_DOUBLE_EQ)
+#undef EXPECT_ARRAY_NEAR
+#define EXPECT_ARRAY_NEAR(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_ARRAY_NEAR)
+#undef ASSERT_ARRAY_EQ
+#define ASSERT_ARRAY_EQ(...) PICOTEST_NEEDS_FULL_HEADER(ASSERT_ARRAY_EQ)
+#undef ASSERT_ARRAY_FLOAT_EQ
+#define ASSERT_ARRAY_FLOAT_EQ(...) PICOTEST_NEEDS_FULL_HEADER(ASSERT_ARRAY_FLOAT_EQ)
+#undef ASSERT_ARRAY_DOUBLE_EQ
+#define ASSERT_ARRAY_DOUBLE_EQ(...) PICOTEST_NEEDS_FULL_HEADER(ASSERT_ARRAY_DOUBLE_EQ)
+#undef ASSERT_ARRAY_NEAR
+#define ASSERT_ARRAY_NEAR(...) PICOTEST_NEEDS_FULL_HEADER(ASSERT_ARRAY_NEAR)
+#undef EXPECT_PERCENTILE_LE
+#define EXPECT_PERCENTILE_LE(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_PERCENTILE_LE)
+#undef ASSERT_PERCENTILE_LE
+#define ASSERT_PERCENTILE_LE(...) PICOTEST_NEEDS_FULL_HEADER(ASSERT_PERCENTILE_LE)
+#undef EXPECT_MAX_ALLOCS
+#define EXPECT_MAX_ALLOCS(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_MAX_ALLOCS)
+#undef EXPECT_NO_ALLOC
+#define EXPECT_NO_ALLOC PICOTEST_NEEDS_FULL_HEADER(EXPECT_NO_ALLOC)
+#undef EXPECT_PERF_COUNTER_LT
+#define EXPECT_PERF_COUNTER_LT(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_PERF_COUNTER_LT)
+#undef EXPECT_CACHE_MISSES_LT
+#define EXPECT_CACHE_MISSES_LT(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_CACHE_MISSES_LT)
+#undef EXPECT_NOT_SLOWER_THAN_BASELINE
+#define EXPECT_NOT_SLOWER_THAN_BASELINE(...) PICOTEST_NEEDS_FULL_HEADER(EXPECT_NOT_SLOWER_THAN_BASELINE)
+#endif // ifdef PICOTEST_LIGHT
 
-inline int RUN_ALL_TESTS() {
-    picotest::framework::Registry::getInstance().testRun(std::cout);
-    picotest::framework::Registry::getInstance().report(std::cout); 
-    return picotest::framework::Registry::getInstance().fail() ? 1 : 0;
+
+/////////////////////////////////////////////////////////////////
+// allocation tracking
+//
+// define PICOTEST_TRACK_ALLOCATIONS before including picotest.h in exactly one translation unit
+// (e.g. the one with main) to replace the global operator new/delete.
+
+#ifdef PICOTEST_TRACK_ALLOCATIONS
+
+#ifdef PICOTEST_LIGHT
+#error "define PICOTEST_TRACK_ALLOCATIONS in the translation unit with PICOTEST_IMPLEMENTATION"
+#endif
+
+namespace picotest {
+namespace detail {
+    static const bool allocation_tracking_installed = (allocationTrackingEnabled() = true);
+}
+}
+
+void* operator new(std::size_t size) {
+    return picotest::framework::allocateTrackedOrThrow(size, 0);
+}
+
+void* operator new[](std::size_t size) {
+    return picotest::framework::allocateTrackedOrThrow(size, 0);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return picotest::framework::allocateTracked(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return picotest::framework::allocateTracked(size, 0);
+}
+
+void operator delete(void* p) noexcept {
+    picotest::framework::freeTracked(p, 0);
 }
 
+void operator delete[](void* p) noexcept {
+    picotest::framework::freeTracked(p, 0);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    picotest::framework::freeTracked(p, 0);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    picotest::framework::freeTracked(p, 0);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, std::size_t) noexcept {
+    picotest::framework::freeTracked(p, 0);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    picotest::framework::freeTracked(p, 0);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t align) {
+    return picotest::framework::allocateTrackedOrThrow(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return picotest::framework::allocateTrackedOrThrow(size, static_cast<std::size_t>(align));
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return picotest::framework::allocateTracked(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return picotest::framework::allocateTracked(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p, std::align_val_t align) noexcept {
+    picotest::framework::freeTracked(p, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void* p, std::align_val_t align) noexcept {
+    picotest::framework::freeTracked(p, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p, std::align_val_t align, const std::nothrow_t&) noexcept {
+    picotest::framework::freeTracked(p, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void* p, std::align_val_t align, const std::nothrow_t&) noexcept {
+    picotest::framework::freeTracked(p, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t align) noexcept {
+    picotest::framework::freeTracked(p, static_cast<std::size_t>(align));
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t align) noexcept {
+    picotest::framework::freeTracked(p, static_cast<std::size_t>(align));
+}
+#endif
+
+#endif // ifdef PICOTEST_TRACK_ALLOCATIONS
@@ -0,0 +1,32 @@
+#define PICOTEST_TRACK_ALLOCATIONS
+#include "picotest.h"
+
+#include <vector>
+
+TEST(Allocations, NoAlloc) {
+    std::vector<int> v(100);
+    EXPECT_NO_ALLOC {
+        for (std::size_t i = 0; i < v.size(); i++) v[i] = static_cast<int>(i);
+    }
+    EXPECT_MAX_ALLOCS(1) {
+        std::vector<int> w(v);
+        EXPECT_EQ(v, w);
+    }
+}
+
+int* leaked;
+
+TEST(Failing, Leak) {
+    leaked = new int[16];
+}
+
+TEST(Failing, Allocates) {
+    EXPECT_NO_ALLOC {
+        std::vector<int> v(10);
+        EXPECT_EQ(10u, v.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,102 @@
+#include "picotest.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+TEST(Assertions, Values) {
+    EXPECT_TRUE(1 + 1 == 2);
+    EXPECT_FALSE(1 + 1 == 3);
+    EXPECT_EQ(3, 1 + 2);
+    EXPECT_NE(std::string("a"), std::string("b"));
+    EXPECT_LT(1, 2);
+    EXPECT_LE(2, 2);
+    EXPECT_GT(3, 2);
+    EXPECT_GE(3, 3);
+}
+
+TEST(Assertions, Strings) {
+    EXPECT_STREQ("abc", "abc");
+    EXPECT_STRNE("abc", "abd");
+    EXPECT_STRCASEEQ("abc", "ABC");
+    EXPECT_STRCASENE("abc", "ABD");
+}
+
+TEST(Assertions, FloatingPoint) {
+    EXPECT_FLOAT_EQ(0.3f, 0.1f + 0.2f);
+    EXPECT_DOUBLE_EQ(0.3, 0.1 + 0.2);
+    EXPECT_NEAR(1.0, 1.05, 0.1);
+}
+
+class CounterTest : public ::testing::Test {
+protected:
+    virtual void SetUp() { value_ = 1; }
+
+    int value_;
+};
+
+TEST_F(CounterTest, SetUpRuns) {
+    EXPECT_EQ(1, value_);
+}
+
+TEST(Arrays, Floats) {
+    std::vector<float> expected(1000, 0.5f), actual(1000, 0.25f);
+    for (std::size_t i = 0; i < actual.size(); i++) actual[i] += 0.25f;
+
+    EXPECT_ARRAY_FLOAT_EQ(expected.data(), actual.data(), actual.size());
+    EXPECT_ARRAY_NEAR(expected.data(), actual.data(), actual.size(), 1e-6);
+    EXPECT_MEM_EQ(expected.data(), actual.data(), actual.size() * sizeof(float));
+}
+
+// the difference is taken the right way round, as it would wrap around
+TEST(Arrays, Unsigned) {
+    const uint32_t expected[] = { 10, 20, 30 }, actual[] = { 12, 19, 30 };
+    const uint64_t big[] = { 0, 1ULL << 40 };
+
+    EXPECT_ARRAY_NEAR(expected, actual, 3, 2);
+    EXPECT_ARRAY_NEAR(big, big, 2, 0);
+    EXPECT_NEAR(19u, 20u, 1u);
+}
+
+TEST(Failing, Eq) {
+    EXPECT_EQ(1, 2);
+}
+
+TEST(Failing, AssertReturns) {
+    ASSERT_TRUE(false);
+    EXPECT_STREQ("never", "reached");
+}
+
+TEST(Failing, Repeated) {
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(0, i + 1);
+}
+
+// four call sites failing once each, for --picotest_max_failures
+TEST(Failing, Sites) {
+    EXPECT_EQ(0, 1);
+    EXPECT_EQ(0, 2);
+    EXPECT_EQ(0, 3);
+    EXPECT_EQ(0, 4);
+}
+
+TEST(Failing, Arrays) {
+    std::vector<double> expected(100, 1.0), actual(expected);
+    actual[42] = 2.0;
+    EXPECT_ARRAY_DOUBLE_EQ(expected.data(), actual.data(), actual.size());
+}
+
+// three differences far apart in a large buffer, for the windowed hexdump
+TEST(Failing, Mem) {
+    std::vector<unsigned char> expected(4096), actual(4096);
+    for (size_t i = 0; i < expected.size(); i++)
+        expected[i] = actual[i] = static_cast<unsigned char>(i);
+    actual[100] ^= 0xff;
+    actual[2000] ^= 0xff;
+    actual[4000] ^= 0xff;
+    EXPECT_MEM_EQ(expected.data(), actual.data(), expected.size());
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
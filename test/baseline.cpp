@@ -0,0 +1,19 @@
+#include "picotest.h"
+
+#include <cstdlib>
+#include <thread>
+
+// PICOTEST_SLOW makes every iteration sleep, to check that a regression against the baseline is caught
+BENCHMARK(Baseline, Sum) {
+    const bool slow = getenv("PICOTEST_SLOW") != 0;
+    int sum = 0;
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) sum += i;
+        benchmark::DoNotOptimize(sum);
+        if (slow) std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
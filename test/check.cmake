@@ -0,0 +1,37 @@
+# runs COMMAND with ARGS (one string, split like a shell command line) in WORKING_DIRECTORY and checks what it did:
+# its exit code must be EXIT (if given), every regular expression EXPECT0, EXPECT1, ... must match its output
+# (stdout and stderr, colors removed) and none of REJECT0, REJECT1, ... may. ENV holds "NAME=VALUE" pairs
+# separated by spaces, set for the command only. with FILE, the expressions are matched against the content of
+# that file (relative to WORKING_DIRECTORY) after the command has run instead.
+separate_arguments(args UNIX_COMMAND "${ARGS}")
+separate_arguments(env UNIX_COMMAND "${ENV}")
+foreach(pair ${env})
+    string(REGEX REPLACE "=.*" "" name "${pair}")
+    string(REGEX REPLACE "^[^=]*=" "" value "${pair}")
+    set(ENV{${name}} "${value}")
+endforeach()
+
+execute_process(COMMAND "${COMMAND}" ${args}
+                WORKING_DIRECTORY "${WORKING_DIRECTORY}"
+                RESULT_VARIABLE result
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE output)
+
+string(ASCII 27 escape)
+string(REGEX REPLACE "${escape}\\[[0-9;]*m" "" output "${output}")
+message("${output}")
+if(DEFINED FILE)
+    file(READ "${WORKING_DIRECTORY}/${FILE}" output)
+endif()
+
+if(DEFINED EXIT AND NOT "${result}" STREQUAL "${EXIT}")
+    message(FATAL_ERROR "exited with '${result}', expected ${EXIT}")
+endif()
+foreach(i RANGE 0 31)
+    if(DEFINED EXPECT${i} AND NOT output MATCHES "${EXPECT${i}}")
+        message(FATAL_ERROR "the output does not match '${EXPECT${i}}'")
+    endif()
+    if(DEFINED REJECT${i} AND output MATCHES "${REJECT${i}}")
+        message(FATAL_ERROR "the output matches '${REJECT${i}}'")
+    endif()
+endforeach()
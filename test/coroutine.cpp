@@ -0,0 +1,26 @@
+#include "picotest.h"
+
+#include <chrono>
+
+picotest::Event ready;
+
+CO_TEST(Coroutine, Waits) {
+    co_await ready.wait();
+    CO_ASSERT_TRUE(true);
+}
+
+CO_TEST(Coroutine, SleepsAnHour) {
+    const auto start = picotest::now();
+    co_await picotest::sleepFor(std::chrono::hours(1));
+    EXPECT_GE(picotest::now() - start, std::chrono::hours(1));
+    ready.set();
+}
+
+CO_TEST(Failing, Deadlock) {
+    static picotest::Event never;
+    co_await never.wait();
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,59 @@
+#include "picotest.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// what the environment and SetUpTestCase/TearDownTestCase did, printed when the environment is torn down
+static std::string events;
+
+class Shared : public ::testing::Test {
+protected:
+    static void SetUpTestCase() {
+        events += "testcase set up, ";
+        table = new std::vector<int>(1000, 1);
+    }
+
+    static void TearDownTestCase() {
+        events += "testcase torn down, ";
+        delete table;
+        table = 0;
+    }
+
+    static std::vector<int>* table;
+};
+
+std::vector<int>* Shared::table = 0;
+
+TEST_F(Shared, First) {
+    ASSERT_TRUE(table != 0);
+    EXPECT_EQ(1000u, table->size());
+}
+
+TEST_F(Shared, Second) {
+    ASSERT_TRUE(table != 0);
+    EXPECT_EQ(1, (*table)[999]);
+}
+
+TEST_F(Shared, Third) {
+    ASSERT_TRUE(table != 0);
+}
+
+class Global : public ::testing::Environment {
+public:
+    virtual void SetUp() { events += "environment set up, "; }
+
+    virtual void TearDown() {
+        events += "environment torn down";
+        fprintf(stderr, "events: %s\n", events.c_str());
+    }
+};
+
+TEST(Environment, SetUpFirst) {
+    EXPECT_EQ(0u, events.find("environment set up, "));
+}
+
+int main(int argc, char** argv) {
+    ::testing::AddGlobalTestEnvironment(new Global);
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,29 @@
+#include "picotest.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+
+TEST(Worker, Passes) {
+    EXPECT_TRUE(true);
+}
+
+TEST(Worker, Fails) {
+    EXPECT_EQ(std::string("sent"), std::string("from the worker"));
+}
+
+TEST(Crash, Abort) {
+    abort();
+}
+
+TEST(Crash, Exit) {
+    exit(3);
+}
+
+TEST_TIMEOUT(Hang, Forever, 200) {
+    for (;;) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
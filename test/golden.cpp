@@ -0,0 +1,39 @@
+#include "picotest.h"
+
+#include <string>
+#include <vector>
+
+static std::string golden(const char* name) {
+    return std::string(PICOTEST_TEST_SOURCE_DIR "/golden/") + name;
+}
+
+TEST(Golden, Matches) {
+    EXPECT_MATCHES_GOLDEN(std::string("hello\nworld\n"), golden("greeting.txt"));
+}
+
+TEST(Golden, Empty) {
+    EXPECT_MATCHES_GOLDEN(std::string(), golden("empty.txt"));
+}
+
+TEST(Failing, Text) {
+    EXPECT_MATCHES_GOLDEN(std::string("hello\nwarld\n"), golden("greeting.txt"));
+}
+
+TEST(Failing, Empty) {
+    EXPECT_MATCHES_GOLDEN(std::string("not empty\n"), golden("empty.txt"));
+}
+
+TEST(Failing, Missing) {
+    EXPECT_MATCHES_GOLDEN(std::string("anything"), golden("missing.txt"));
+}
+
+// written with --update_goldens, relative to the working directory
+TEST(Update, Binary) {
+    std::vector<unsigned char> bytes(300);
+    for (std::size_t i = 0; i < bytes.size(); i++) bytes[i] = static_cast<unsigned char>(i * 7);
+    EXPECT_MATCHES_GOLDEN(bytes, "updated/bytes.bin");
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,33 @@
+#include "picotest.h"
+
+TEST(Histogram, Percentiles) {
+    picotest::LatencyHistogram h;
+    for (int i = 1; i <= 1000; i++) h.record(i * 1000);
+
+    EXPECT_EQ(1000u, h.count());
+    EXPECT_NEAR(500000.0, static_cast<double>(h.valueAtPercentile(50)), 500000 * 0.008);
+    EXPECT_NEAR(990000.0, static_cast<double>(h.valueAtPercentile(99)), 990000 * 0.008);
+    EXPECT_PERCENTILE_LE(h, 99.9, std::chrono::milliseconds(2));
+}
+
+TEST(Histogram, Add) {
+    picotest::LatencyHistogram a, b;
+    a.record(100);
+    b.record(200);
+    a.add(b);
+
+    EXPECT_EQ(2u, a.count());
+    EXPECT_EQ(100u, a.min());
+    EXPECT_EQ(200u, a.max());
+}
+
+TEST(Failing, Tail) {
+    picotest::LatencyHistogram h;
+    for (int i = 1; i <= 1000; i++) h.record(i > 990 ? 50000000 : 1000);
+
+    EXPECT_PERCENTILE_LE(h, 99.9, std::chrono::microseconds(10));
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,24 @@
+#include "picotest.h"
+
+#include <tuple>
+
+class SquareTest : public testing::TestWithParam<int> {};
+
+TEST_P(SquareTest, NonNegative) {
+    EXPECT_GE(GetParam() * GetParam(), 0);
+}
+
+INSTANTIATE_TEST_CASE_P(Small, SquareTest, testing::Range(-5, 5));
+
+class ParityTest : public testing::TestWithParam<std::tuple<int, bool> > {};
+
+TEST_P(ParityTest, Matches) {
+    EXPECT_EQ(std::get<1>(GetParam()), std::get<0>(GetParam()) % 2 == 0);
+}
+
+// only the even/true and odd/false combinations hold, so half of the instances fail
+INSTANTIATE_TEST_CASE_P(Failing, ParityTest, testing::Combine(testing::Values(2, 3), testing::Bool()));
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,38 @@
+#include "picotest.h"
+
+#include <vector>
+
+// touches fresh pages, so that the page faults have something to count
+static int touchPages() {
+    std::vector<char> pages(1 << 22);
+    for (std::size_t i = 0; i < pages.size(); i += 4096) pages[i] = 1;
+    return pages[pages.size() - 4096];
+}
+
+TEST(Perf, Touches) {
+    EXPECT_EQ(1, touchPages());
+}
+
+// page faults and context switches are software counters, available on any Linux
+TEST(Perf, PageFaultsBelow) {
+    EXPECT_PERF_COUNTER_LT(PageFaults, 1e9) {
+        EXPECT_EQ(1, touchPages());
+    }
+}
+
+// hardware counters need PMU access: checked where there is, skipped with a note otherwise
+TEST(Perf, CyclesBelow) {
+    EXPECT_PERF_COUNTER_LT(Cycles, 1e12) {
+        EXPECT_EQ(1, touchPages());
+    }
+}
+
+TEST(Failing, PageFaults) {
+    EXPECT_PERF_COUNTER_LT(PageFaults, 1) {
+        EXPECT_EQ(1, touchPages());
+    }
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,21 @@
+#include "picotest.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace gen = picotest::gen;
+
+PROPERTY(Property, ReverseTwice, gen::vector(gen::integer<int>())) {
+    std::vector<int> v = GetArg<0>();
+    std::reverse(v.begin(), v.end());
+    std::reverse(v.begin(), v.end());
+    EXPECT_TRUE(v == GetArg<0>());
+}
+
+PROPERTY(Shrink, Below100, gen::integer<int>()) {
+    EXPECT_LT(GetArg<0>(), 100);
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,22 @@
+#include "picotest.h"
+
+#include <chrono>
+#include <thread>
+
+TEST(Report, Quick) {
+    EXPECT_TRUE(true);
+}
+
+// the slowest test, for --picotest_slowest and --picotest_time_budget_ms: far enough from Quick that
+// preemption under a loaded ctest -j does not change which test is over the budget
+TEST(Report, Sleeps) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+}
+
+TEST(Failing, Eq) {
+    EXPECT_EQ(1, 2);
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
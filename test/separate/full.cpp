@@ -0,0 +1,12 @@
+#define PICOTEST_FULL_HEADER
+#include "picotest.h"
+
+BENCHMARK(Full, Loop) {
+    int sum = 0;
+    while (state.KeepRunning()) benchmark::DoNotOptimize(sum += 1);
+}
+
+TEST(Full, Arrays) {
+    const double a[] = { 1.0, 2.0, 3.0 };
+    EXPECT_ARRAY_DOUBLE_EQ(a, a, 3);
+}
@@ -0,0 +1,19 @@
+#include "picotest.h"
+
+#include <string>
+
+TEST(Light, Values) {
+    EXPECT_EQ(4, 2 * 2);
+    EXPECT_STREQ("light", std::string("light").c_str());
+}
+
+class LightFixture : public ::testing::Test {
+protected:
+    virtual void SetUp() { text_ = "set up"; }
+
+    std::string text_;
+};
+
+TEST_F(LightFixture, SetUp) {
+    EXPECT_EQ(std::string("set up"), text_);
+}
@@ -0,0 +1,6 @@
+#define PICOTEST_IMPLEMENTATION
+#include "picotest.h"
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
@@ -0,0 +1,7 @@
+// a light translation unit using a macro of the full header; must not compile (see CMakeLists.txt)
+#include "picotest.h"
+
+TEST(Light, Misuse) {
+    const int values[] = { 1, 2 };
+    EXPECT_ARRAY_EQ(values, values, 2);
+}
@@ -0,0 +1,30 @@
+#include "picotest.h"
+
+#include <atomic>
+
+std::atomic<int> counter(0);
+
+STRESS_TEST(Stress, Counts, 4, 1000) {
+    while (state.KeepRunning()) counter++;
+}
+
+class SharedCounter : public ::testing::Test {
+protected:
+    virtual void SetUp() { value_ = 0; }
+    virtual void TearDown() { EXPECT_EQ(4 * 500, value_.load()); }
+
+    std::atomic<int> value_;
+};
+
+STRESS_TEST_F(SharedCounter, Increments, 4, 500) {
+    while (state.KeepRunning()) value_++;
+}
+
+// only thread 1 fails, in every iteration
+STRESS_TEST(Failing, SecondThread, 2, 100) {
+    while (state.KeepRunning()) EXPECT_EQ(0u, state.threadIndex());
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}
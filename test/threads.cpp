@@ -0,0 +1,81 @@
+#include "picotest.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// one long-lived worker shared by several tests, like a thread pool: its failures go to the test
+// which handed it the job, also after an earlier test has merged (and released) its buffer
+class Pool {
+public:
+    static Pool& getInstance() {
+        static Pool* instance = new Pool; // never destroyed: the worker still waits on it at exit
+        return *instance;
+    }
+
+    void run(const std::function<void()>& job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !job_; }); // tests running in parallel take turns
+        job_ = job;
+        cv_.notify_all();
+        cv_.wait(lock, [this] { return !job_; });
+    }
+
+private:
+    Pool() : thread_([this] { loop(); }) {
+        thread_.detach();
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this] { return static_cast<bool>(job_); });
+            job_();
+            job_ = nullptr;
+            cv_.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::function<void()> job_;
+    std::thread thread_;
+};
+
+TEST(Spawned, Fails) {
+    std::thread worker([] { EXPECT_EQ(1, 2); });
+    worker.join();
+}
+
+TEST(Spawned, Adopted) {
+    picotest::framework::Test* test = picotest::framework::TestState::getCurrentTest();
+    std::thread worker([test] { picotest::framework::AdoptTest adopt(test); EXPECT_EQ(3, 4); });
+    worker.join();
+}
+
+TEST(Spawned, Many) {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++)
+        workers.push_back(std::thread([] {
+            for (int i = 0; i < 1000; i++) EXPECT_LT(i, 0);
+        }));
+    for (std::size_t t = 0; t < workers.size(); t++) workers[t].join();
+}
+
+TEST(Pool, First) {
+    Pool::getInstance().run([] { EXPECT_EQ(5, 6); });
+}
+
+TEST(Pool, Second) {
+    Pool::getInstance().run([] { EXPECT_EQ(7, 8); });
+}
+
+TEST(Pool, Passes) {
+    Pool::getInstance().run([] { EXPECT_EQ(9, 9); });
+}
+
+int main(int argc, char** argv) {
+    return RUN_ALL_TESTS(argc, argv);
+}